@@ -1,36 +1,52 @@
 #include "debug.h"
-#include <set>
+#include <iostream>
+#include <sstream>
+#include <string>
 
-extern double get_current_time();
+#include "../run/params.h"
+
+extern DCExpParams params;
 
-bool debug_mode = true;
 bool print_flow = true;
-double debug_start_time = 0;
-
-bool debug_all_flows = false;
-std::set<uint32_t> flows_to_debug_set = {};
-bool debug_all_queues = false;
-std::set<uint32_t> queues_to_debug_set = {};
-bool debug_all_hosts = false;
-std::set<uint32_t> hosts_to_debug_set = {};
-
-bool debug_flow(uint32_t fid){
-    return false;
-    //return debug_mode && get_current_time() >= debug_start_time?(debug_all_flows||flows_to_debug_set.count(fid)):false;
-}
 
+#ifdef SIM_TRACE
+TraceFilter trace_filters[TRACE_NUM_CATEGORIES];
+double trace_start_time = 0;
 
-bool debug_queue(uint32_t qid){
-    return debug_mode && get_current_time() >= debug_start_time?(debug_all_queues||queues_to_debug_set.count(qid)):false;
+void TraceFilter::set(uint32_t id) {
+    if ((id >> 6) >= words.size()) {
+        words.resize((id >> 6) + 1, 0);
+    }
+    words[id >> 6] |= 1ULL << (id & 63);
 }
 
-bool debug_host(uint32_t qid){
-    return debug_mode &&  get_current_time() >= debug_start_time?(debug_all_hosts||hosts_to_debug_set.count(qid)):false;
+// "none", "all" or comma separated ids
+static void parse_trace_ids(std::string ids, TraceFilter &filter) {
+    filter.all = ids == "all";
+    filter.words.clear();
+    if (filter.all || ids == "none") {
+        return;
+    }
+    std::istringstream s(ids);
+    std::string id;
+    while (std::getline(s, id, ',')) {
+        filter.set(std::stoul(id));
+    }
 }
 
-bool debug(){
-    return debug_mode &&  get_current_time() >= debug_start_time;
+void init_trace() {
+    parse_trace_ids(params.trace_flows, trace_filters[TRACE_FLOW]);
+    parse_trace_ids(params.trace_queues, trace_filters[TRACE_QUEUE]);
+    parse_trace_ids(params.trace_hosts, trace_filters[TRACE_HOST]);
+    trace_start_time = params.trace_start_time;
+}
+#else
+void init_trace() {
+    if (params.trace_flows != "none" || params.trace_queues != "none" || params.trace_hosts != "none") {
+        std::cerr << "trace_flows, trace_queues and trace_hosts need a build with SIM_TRACE (simdebug)\n";
+    }
 }
+#endif
 
 bool print_flow_result(){
     return print_flow;
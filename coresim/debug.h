@@ -2,10 +2,57 @@
 #define DEBUG_H
 
 #include <stdint.h>
+#include <vector>
 
-bool debug_flow(uint32_t fid);
-bool debug_queue(uint32_t fid);
-bool debug_host(uint32_t fid);
-bool debug();
+/*
+ * Trace categories. debug_flow(id), debug_queue(id) and debug_host(id) guard
+ * the trace output about one flow, queue or host. They are compiled in only
+ * with SIM_TRACE (the simdebug target); without it they are constant false
+ * and the output they guard is dropped by the compiler. Which ids are traced
+ * is set by the trace_flows, trace_queues and trace_hosts params, from
+ * trace_start_time on.
+ */
+#define TRACE_FLOW 0
+#define TRACE_QUEUE 1
+#define TRACE_HOST 2
+#define TRACE_NUM_CATEGORIES 3
+
+#ifdef SIM_TRACE
+// the traced ids of one category, one bit each
+struct TraceFilter {
+    bool all;
+    std::vector<uint64_t> words;
+    bool test(uint32_t id) const {
+        return all || ((id >> 6) < words.size() && ((words[id >> 6] >> (id & 63)) & 1));
+    }
+    void set(uint32_t id);
+};
+
+extern TraceFilter trace_filters[TRACE_NUM_CATEGORIES];
+extern double trace_start_time;
+extern double current_time;
+
+inline bool trace_on(uint32_t category, uint32_t id) {
+    return current_time >= trace_start_time && trace_filters[category].test(id);
+}
+#else
+inline bool trace_on(uint32_t, uint32_t) {
+    return false;
+}
+#endif
+
+inline bool debug_flow(uint32_t fid) {
+    return trace_on(TRACE_FLOW, fid);
+}
+
+inline bool debug_queue(uint32_t qid) {
+    return trace_on(TRACE_QUEUE, qid);
+}
+
+inline bool debug_host(uint32_t hid) {
+    return trace_on(TRACE_HOST, hid);
+}
+
+void init_trace();  // after the params are read
 bool print_flow_result();
 #endif
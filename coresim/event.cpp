@@ -16,6 +16,10 @@
 #include "../ext/factory.h"
 
 #include "../run/params.h"
+#include "../run/result_sink.h"
+#include "../run/stats.h"
+#include "../run/early_stop.h"
+#include "../run/fingerprint.h"
 
 extern Topology* topology;
 extern std::priority_queue<Event*, std::vector<Event*>, EventComparator> event_queue;
@@ -49,19 +53,33 @@ extern EmpiricalRandomVariable *nv_bytes;
 extern double get_current_time();
 extern void add_to_event_queue(Event *);
 extern int get_event_queue_size();
-
-uint32_t Event::instance_count = 0;
+extern Event *get_next_flow_arrival();
+extern void retire_flow(Flow *f, double oracle_fct);
+extern ResultSink *result_sink;
+extern FlowSizeStats flow_size_stats;
+extern EarlyStop early_stop;
+extern bool flow_arrivals_stopped;
+extern void stop_flow_arrivals();
+extern bool in_measurement_window(Flow *f);
+extern Fingerprint *fingerprint;
+
+uint64_t Event::instance_count = 0;
 
 Event::Event(uint32_t type, double time) {
     this->type = type;
     this->time = time;
     this->cancelled = false;
     this->unique_id = Event::instance_count++;
+    this->order = this->unique_id;
 }
 
 Event::~Event() {
 }
 
+uint32_t Event::target_id() {
+    return 0;
+}
+
 
 /* Flow Arrival */
 FlowCreationForInitializationEvent::FlowCreationForInitializationEvent(
@@ -80,13 +98,42 @@ FlowCreationForInitializationEvent::FlowCreationForInitializationEvent(
 FlowCreationForInitializationEvent::~FlowCreationForInitializationEvent() {}
 
 void FlowCreationForInitializationEvent::process_event() {
+    Flow *f = create_flow(flows_to_schedule.size());
+    if (f != NULL) {
+        flows_to_schedule.push_back(f);
+    }
+    add_to_event_queue(next_event());
+}
+
+Flow *FlowCreationForInitializationEvent::create_flow(uint32_t id) {
+    return create_flow(id, time, src, dst, nv_bytes);
+}
+
+// Draws a flow size and returns the new flow, or NULL for a zero sized draw.
+Flow *FlowCreationForInitializationEvent::create_flow(
+        uint32_t id,
+        double time,
+        Host *src,
+        Host *dst,
+        EmpiricalRandomVariable *nv_bytes
+    ) {
+    return create_flow(id, time, src, dst, nv_bytes->value());
+}
+
+// Same, for a size already drawn from nv_bytes (parallel generation).
+Flow *FlowCreationForInitializationEvent::create_flow(
+        uint32_t id,
+        double time,
+        Host *src,
+        Host *dst,
+        double size_draw
+    ) {
     uint32_t nvVal, size;
-    uint32_t id = flows_to_schedule.size();
     if (params.bytes_mode) {
-        nvVal = nv_bytes->value();
+        nvVal = size_draw;
         size = (uint32_t) nvVal;
     } else {
-        nvVal = (nv_bytes->value() + 0.5); // truncate(val + 0.5) equivalent to round to nearest int
+        nvVal = (size_draw + 0.5); // truncate(val + 0.5) equivalent to round to nearest int
         if (nvVal > 2500000) {
             std::cout << "Giant Flow! event.cpp::FlowCreation:" << 1000000.0 * time << " Generating new flow " << id << " of size " << (nvVal*1460) << " between " << src->id << " " << dst->id << "\n";
             nvVal = 2500000;
@@ -95,21 +142,22 @@ void FlowCreationForInitializationEvent::process_event() {
     }
 
     if (size != 0) {
-        flows_to_schedule.push_back(Factory::get_flow(id, time, size, src, dst, params.flow_type));
+        return Factory::get_flow(id, time, size, src, dst, params.flow_type);
     }
+    return NULL;
+}
 
+FlowCreationForInitializationEvent *FlowCreationForInitializationEvent::next_event() {
     double tnext = time + nv_intarr->value();
 //        std::cout << "event.cpp::FlowCreation:" << 1000000.0 * time << " Generating new flow " << id << " of size "
 //         << size << " between " << src->id << " " << dst->id << " " << (tnext - get_current_time())*1e6 << "\n";
 
-    add_to_event_queue(
-            new FlowCreationForInitializationEvent(
-                tnext,
-                src, 
-                dst,
-                nv_bytes, 
-                nv_intarr
-                )
+    return new FlowCreationForInitializationEvent(
+            tnext,
+            src, 
+            dst,
+            nv_bytes, 
+            nv_intarr
             );
 }
 
@@ -119,15 +167,22 @@ int flow_arrival_count = 0;
 
 FlowArrivalEvent::FlowArrivalEvent(double time, Flow* flow) : Event(FLOW_ARRIVAL, time) {
     this->flow = flow;
+    flow->hold();
 }
 
 FlowArrivalEvent::~FlowArrivalEvent() {
+    flow->release();
+}
+
+uint32_t FlowArrivalEvent::target_id() {
+    return flow->id;
 }
 
 void FlowArrivalEvent::process_event() {
     //Flows start at line rate; so schedule a packet to be transmitted
     //First packet scheduled to be queued
 
+    this->flow->arrived = true;
     num_outstanding_packets += (this->flow->size / this->flow->mss);
     arrival_packets_count += this->flow->size_in_pkt;
     if (num_outstanding_packets > max_outstanding_packets) {
@@ -139,6 +194,13 @@ void FlowArrivalEvent::process_event() {
         add_to_event_queue(flow_arrivals.front());
         flow_arrivals.pop_front();
     }
+    else if (params.stream_flows && !flow_arrivals_stopped) {
+        // flows are materialized one arrival ahead of the simulation
+        Event *next_arrival = get_next_flow_arrival();
+        if (next_arrival != NULL) {
+            add_to_event_queue(next_arrival);
+        }
+    }
 
     if(params.num_flows_to_run > 10 && flow_arrival_count % 100000 == 0){
         double curr_time = get_current_time();
@@ -173,44 +235,43 @@ PacketQueuingEvent::PacketQueuingEvent(double time, Packet *packet,
         Queue *queue) : Event(PACKET_QUEUING, time) {
     this->packet = packet;
     this->queue = queue;
+    this->upstream = NULL;
+    this->order = packet->unique_id;
 }
 
 PacketQueuingEvent::~PacketQueuingEvent() {
 }
 
-void PacketQueuingEvent::process_event() {
-    if (!queue->busy) {
-        queue->queue_proc_event = new QueueProcessingEvent(get_current_time(), queue);
-        add_to_event_queue(queue->queue_proc_event);
-        queue->busy = true;
-        queue->packet_transmitting = packet;
-    }
-    else if( params.preemptive_queue && this->packet->pf_priority < queue->packet_transmitting->pf_priority) {
-        double remaining_percentage = (queue->queue_proc_event->time - get_current_time()) / queue->get_transmission_delay(queue->packet_transmitting->size);
-
-        if(remaining_percentage > 0.01){
-            queue->preempt_current_transmission();
+uint32_t PacketQueuingEvent::target_id() {
+    return queue->unique_id;
+}
 
-            queue->queue_proc_event = new QueueProcessingEvent(get_current_time(), queue);
-            add_to_event_queue(queue->queue_proc_event);
-            queue->busy = true;
-            queue->packet_transmitting = packet;
-        }
+void PacketQueuingEvent::process_event() {
+    if (upstream != NULL) {
+        upstream->settle();
     }
-
-    queue->enque(packet);
+    queue->accept(packet);
 }
 
 /* Packet Arrival */
 PacketArrivalEvent::PacketArrivalEvent(double time, Packet *packet)
     : Event(PACKET_ARRIVAL, time) {
         this->packet = packet;
+        this->upstream = NULL;
+        this->order = packet->unique_id;
     }
 
 PacketArrivalEvent::~PacketArrivalEvent() {
 }
 
+uint32_t PacketArrivalEvent::target_id() {
+    return packet->unique_id;
+}
+
 void PacketArrivalEvent::process_event() {
+    if (upstream != NULL) {
+        upstream->settle();
+    }
     if (packet->type == NORMAL_PACKET) {
         completed_packets++;
     }
@@ -232,36 +293,22 @@ QueueProcessingEvent::~QueueProcessingEvent() {
     }
 }
 
+uint32_t QueueProcessingEvent::target_id() {
+    return queue->unique_id;
+}
+
 void QueueProcessingEvent::process_event() {
     Packet *packet = queue->deque();
     if (packet) {
         queue->busy = true;
         queue->busy_events.clear();
         queue->packet_transmitting = packet;
-        Queue *next_hop = topology->get_next_hop(packet, queue);
         double td = queue->get_transmission_delay(packet->size);
-        double pd = queue->propagation_delay;
         //double additional_delay = 1e-10;
         queue->queue_proc_event = new QueueProcessingEvent(time + td, queue);
         add_to_event_queue(queue->queue_proc_event);
         queue->busy_events.push_back(queue->queue_proc_event);
-        if (next_hop == NULL) {
-            Event* arrival_evt = new PacketArrivalEvent(time + td + pd, packet);
-            add_to_event_queue(arrival_evt);
-            queue->busy_events.push_back(arrival_evt);
-        } else {
-            Event* queuing_evt = NULL;
-            if (params.cut_through == 1) {
-                double cut_through_delay =
-                    queue->get_transmission_delay(packet->flow->hdr_size);
-                queuing_evt = new PacketQueuingEvent(time + cut_through_delay + pd, packet, next_hop);
-            } else {
-                queuing_evt = new PacketQueuingEvent(time + td + pd, packet, next_hop);
-            }
-
-            add_to_event_queue(queuing_evt);
-            queue->busy_events.push_back(queuing_evt);
-        }
+        queue->busy_events.push_back(queue->transmit(packet, time));
     } else {
         queue->busy = false;
         queue->busy_events.clear();
@@ -292,25 +339,36 @@ void LoggingEvent::process_event() {
 FlowFinishedEvent::FlowFinishedEvent(double time, Flow *flow)
     : Event(FLOW_FINISHED, time) {
         this->flow = flow;
+        flow->hold();
     }
 
-FlowFinishedEvent::~FlowFinishedEvent() {}
+FlowFinishedEvent::~FlowFinishedEvent() {
+    flow->release();
+}
+
+uint32_t FlowFinishedEvent::target_id() {
+    return flow->id;
+}
 
 void FlowFinishedEvent::process_event() {
     this->flow->finished = true;
     this->flow->finish_time = get_current_time();
     this->flow->flow_completion_time = this->flow->finish_time - this->flow->start_time;
     total_finished_flows++;
-    auto slowdown = 1000000 * flow->flow_completion_time / topology->get_oracle_fct(flow);
+    double oracle_fct = topology->get_oracle_fct(flow);
+    auto slowdown = 1000000 * flow->flow_completion_time / oracle_fct;
     if (slowdown < 1.0 && slowdown > 0.9999) {
         slowdown = 1.0;
     }
     if (slowdown < 1.0) {
-        std::cout << "bad slowdown " << 1e6 * flow->flow_completion_time << " " << topology->get_oracle_fct(flow) << " " << slowdown << "\n";
+        std::cout << "bad slowdown " << 1e6 * flow->flow_completion_time << " " << oracle_fct << " " << slowdown << "\n";
     }
     assert(slowdown >= 1.0);
 
-    if (print_flow_result()) {
+    if (result_sink != NULL) {
+        result_sink->write(flow, oracle_fct, slowdown);
+    }
+    else if (print_flow_result()) {
         std::cout << std::setprecision(4) << std::fixed ;
         std::cout
             << flow->id << " "
@@ -320,14 +378,31 @@ void FlowFinishedEvent::process_event() {
             << 1000000 * flow->start_time << " "
             << 1000000 * flow->finish_time << " "
             << 1000000.0 * flow->flow_completion_time << " "
-            << topology->get_oracle_fct(flow) << " "
+            << oracle_fct << " "
             << slowdown << " "
             << flow->total_pkt_sent << "/" << (flow->size/flow->mss) << "//" << flow->received_count << " "
             << flow->data_pkt_drop << "/" << flow->ack_pkt_drop << "/" << flow->pkt_drop << " "
             << 1000000 * (flow->first_byte_send_time - flow->start_time) << " "
-            << std::endl;
+            << "\n";
         std::cout << std::setprecision(9) << std::fixed;
     }
+
+    if (fingerprint != NULL) {
+        fingerprint->add_flow_result(flow);
+    }
+
+    if (in_measurement_window(flow)) {
+        if (params.size_bucket_stats) {
+            flow_size_stats.add(flow->size, 1000000.0 * flow->flow_completion_time, slowdown);
+        }
+        if (params.stop_ci_width > 0 && early_stop.add(flow->size, slowdown)) {
+            stop_flow_arrivals();
+        }
+    }
+
+    if (params.retire_flows) {
+        retire_flow(flow, oracle_fct);
+    }
 }
 
 
@@ -335,12 +410,18 @@ void FlowFinishedEvent::process_event() {
 FlowProcessingEvent::FlowProcessingEvent(double time, Flow *flow)
     : Event(FLOW_PROCESSING, time) {
         this->flow = flow;
+        flow->hold();
     }
 
 FlowProcessingEvent::~FlowProcessingEvent() {
     if (flow->flow_proc_event == this) {
         flow->flow_proc_event = NULL;
     }
+    flow->release();
+}
+
+uint32_t FlowProcessingEvent::target_id() {
+    return flow->id;
 }
 
 void FlowProcessingEvent::process_event() {
@@ -352,15 +433,45 @@ void FlowProcessingEvent::process_event() {
 RetxTimeoutEvent::RetxTimeoutEvent(double time, Flow *flow)
     : Event(RETX_TIMEOUT, time) {
         this->flow = flow;
+        flow->hold();
     }
 
 RetxTimeoutEvent::~RetxTimeoutEvent() {
     if (flow->retx_event == this) {
         flow->retx_event = NULL;
     }
+    flow->release();
+}
+
+uint32_t RetxTimeoutEvent::target_id() {
+    return flow->id;
 }
 
 void RetxTimeoutEvent::process_event() {
     flow->handle_timeout();
 }
 
+/* Delayed Ack */
+DelayedAckEvent::DelayedAckEvent(double time, Flow *flow)
+    : Event(DELAYED_ACK, time) {
+        this->flow = flow;
+        flow->hold();
+    }
+
+DelayedAckEvent::~DelayedAckEvent() {
+    if (flow->delayed_ack_event == this) {
+        flow->delayed_ack_event = NULL;
+    }
+    flow->release();
+}
+
+uint32_t DelayedAckEvent::target_id() {
+    return flow->id;
+}
+
+void DelayedAckEvent::process_event() {
+    if (!flow->finished) {
+        flow->send_delayed_ack();
+    }
+}
+
@@ -28,6 +28,7 @@
 #define FLOW_PROCESSING 7
 #define FLOW_CREATION_EVENT 8
 #define LOGGING 9
+#define DELAYED_ACK 17
 
 class Event {
     public:
@@ -48,23 +49,29 @@ class Event {
         }
 
         virtual void process_event() = 0;
+        virtual uint32_t target_id();   // the flow, queue, packet or host acted on
 
-        uint32_t unique_id;
-        static uint32_t instance_count;
+        uint64_t unique_id;
+        static uint64_t instance_count;
+        uint64_t order;     // breaks ties in time and type; 64 bits, as long runs make over 2^32
 
-        uint32_t type;
         double time;
+        uint32_t type;
         bool cancelled;
 };
 
+// events at the same time run by type, then in the order they were made;
+// packet events go by packet, so sending ahead (packet_trains) keeps the order
 struct EventComparator
 {
     bool operator() (Event *a, Event *b) {
-        if (fabs(a->time - b->time) < 1e-15) {
-            return a->type > b->type;
-        } else {
+        if (a->time != b->time) {
             return a->time > b->time;
         }
+        if (a->type != b->type) {
+            return a->type > b->type;
+        }
+        return a->order > b->order;
     }
 };
 
@@ -80,6 +87,10 @@ class FlowCreationForInitializationEvent : public Event {
                 );
         ~FlowCreationForInitializationEvent();
         void process_event();
+        Flow *create_flow(uint32_t id);
+        static Flow *create_flow(uint32_t id, double time, Host *src, Host *dst, EmpiricalRandomVariable *nv_bytes);
+        static Flow *create_flow(uint32_t id, double time, Host *src, Host *dst, double size_draw);
+        FlowCreationForInitializationEvent *next_event();
         Host *src;
         Host *dst;
         EmpiricalRandomVariable *nv_bytes;
@@ -92,6 +103,7 @@ class FlowArrivalEvent : public Event {
         FlowArrivalEvent(double time, Flow *flow);
         ~FlowArrivalEvent();
         void process_event();
+        uint32_t target_id();
         Flow *flow;
 };
 
@@ -101,8 +113,10 @@ class PacketQueuingEvent : public Event {
         PacketQueuingEvent(double time, Packet *packet, Queue *queue);
         ~PacketQueuingEvent();
         void process_event();
+        uint32_t target_id();
         Packet *packet;
         Queue *queue;
+        Queue *upstream;    // set if the packet left upstream in a train
 };
 
 // packet arrival
@@ -111,7 +125,9 @@ class PacketArrivalEvent : public Event {
         PacketArrivalEvent(double time, Packet *packet);
         ~PacketArrivalEvent();
         void process_event();
+        uint32_t target_id();
         Packet *packet;
+        Queue *upstream;    // set if the packet left upstream in a train
 };
 
 class QueueProcessingEvent : public Event {
@@ -119,6 +135,7 @@ class QueueProcessingEvent : public Event {
         QueueProcessingEvent(double time, Queue *queue);
         ~QueueProcessingEvent();
         void process_event();
+        uint32_t target_id();
         Queue *queue;
 };
 
@@ -137,6 +154,7 @@ class FlowFinishedEvent : public Event {
         FlowFinishedEvent(double time, Flow *flow);
         ~FlowFinishedEvent();
         void process_event();
+        uint32_t target_id();
         Flow *flow;
 };
 
@@ -147,6 +165,7 @@ class FlowProcessingEvent : public Event {
         ~FlowProcessingEvent();
 
         void process_event();
+        uint32_t target_id();
         Flow *flow;
 };
 
@@ -155,6 +174,16 @@ class RetxTimeoutEvent : public Event {
         RetxTimeoutEvent(double time, Flow *flow);
         ~RetxTimeoutEvent();
         void process_event();
+        uint32_t target_id();
+        Flow *flow;
+};
+
+class DelayedAckEvent : public Event {
+    public:
+        DelayedAckEvent(double time, Flow *flow);
+        ~DelayedAckEvent();
+        void process_event();
+        uint32_t target_id();
         Flow *flow;
 };
 
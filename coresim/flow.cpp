@@ -1,4 +1,5 @@
 #include <math.h>
+#include <algorithm>
 #include <iostream>
 #include <assert.h>
 
@@ -53,12 +54,34 @@ Flow::Flow(uint32_t id, double start_time, uint32_t size, Host *s, Host *d) {
     this->first_byte_receive_time = -1;
     this->first_hop_departure = 0;
     this->last_hop_departure = 0;
+    this->received_count = 0;
+    this->total_queuing_time = 0;
+    this->delayed_acks = 0;
+    this->delayed_ack_event = NULL;
+    this->flow_completion_time = 0;
+    this->deadline = 0;
+    this->refs = 0;
+    this->retired = false;
+    this->detached = false;
+    this->arrived = false;
 }
 
 Flow::~Flow() {
     //  packets.clear();
 }
 
+void Flow::hold() {
+    refs++;
+}
+
+void Flow::release() {
+    assert(refs > 0);
+    refs--;
+    if (refs == 0 && detached) {
+        delete this;
+    }
+}
+
 void Flow::start_flow() {
     send_pending_data();
 }
@@ -72,7 +95,7 @@ void Flow::send_pending_data() {
             ((seq + mss <= size) || (seq != size && (size - seq < mss)))
         ) {
             // TODO Make it explicit through the SACK list
-            if (received.count(seq) == 0) {
+            if (!has_received(seq)) {
                 send(seq);
             }
 
@@ -133,11 +156,20 @@ void Flow::receive_ack(uint32_t ack, std::vector<uint32_t> sack_list) {
 
     // New ack!
     if (ack > last_unacked_seq) {
+        // A delayed ack covers several packets; grow cwnd for each, up to
+        // the number the receiver acks at once
+        uint32_t acked = (ack - last_unacked_seq + mss - 1) / mss;
+        if (acked > params.delayed_ack_freq) {
+            acked = params.delayed_ack_freq;
+        }
+
         // Update the last unacked seq
         last_unacked_seq = ack;
 
         // Adjust cwnd
-        increase_cwnd();
+        for (uint32_t i = 0; i < acked; i++) {
+            increase_cwnd();
+        }
 
         // Send the remaining data
         send_pending_data();
@@ -189,28 +221,15 @@ void Flow::receive(Packet *p) {
 }
 
 void Flow::receive_data_pkt(Packet* p) {
-    received_count++;
-    total_queuing_time += p->total_queuing_delay;
+    bool in_order = p->seq_no == recv_till;
+    mark_receipt(p);
 
-    if (received.count(p->seq_no) == 0) {
-        received[p->seq_no] = true;
-        if(num_outstanding_packets >= ((p->size - hdr_size) / (mss)))
-            num_outstanding_packets -= ((p->size - hdr_size) / (mss));
-        else
-            num_outstanding_packets = 0;
-        received_bytes += (p->size - hdr_size);
-    } else {
-        duplicated_packets_received += 1;
-    }
-    if (p->seq_no > max_seq_no_recv) {
-        max_seq_no_recv = p->seq_no;
-    }
     // Determing which ack to send
     uint32_t s = recv_till;
     bool in_sequence = true;
     std::vector<uint32_t> sack_list;
     while (s <= max_seq_no_recv) {
-        if (received.count(s) > 0) {
+        if (has_received(s)) {
             if (in_sequence) {
                 if (recv_till + mss > this->size) {
                     recv_till = this->size;
@@ -226,7 +245,65 @@ void Flow::receive_data_pkt(Packet* p) {
         s += mss;
     }
 
-    send_ack(recv_till, sack_list); // Cumulative Ack
+    ack_data(in_order, sack_list); // Cumulative Ack
+}
+
+void Flow::mark_receipt(Packet* p) {
+    received_count++;
+    total_queuing_time += p->total_queuing_delay;
+
+    if (!has_received(p->seq_no)) {
+        uint32_t i = p->seq_no / mss;
+        if (i >= received.size()) {
+            received.resize(std::max(i + 1, (uint32_t) size_in_pkt));
+        }
+        received[i] = true;
+        if(num_outstanding_packets >= ((p->size - hdr_size) / (mss)))
+            num_outstanding_packets -= ((p->size - hdr_size) / (mss));
+        else
+            num_outstanding_packets = 0;
+        received_bytes += (p->size - hdr_size);
+    } else {
+        duplicated_packets_received += 1;
+    }
+    if (p->seq_no > max_seq_no_recv) {
+        max_seq_no_recv = p->seq_no;
+    }
+}
+
+// Delayed acks: one ack per delayed_ack_freq data packets, or when the
+// timer runs out. Out of order data, a gap and the last packet are acked
+// at once, so loss recovery and the finish are not held back. So are the
+// first delayed_ack_freq packets of a flow (quick ack), or a sender whose
+// window is still smaller than that would wait for the timer every round.
+void Flow::ack_data(bool in_order, std::vector<uint32_t> &sack_list) {
+    delayed_acks++;
+    if (in_order && sack_list.empty() && recv_till < size && received_count > params.delayed_ack_freq
+            && delayed_acks < params.delayed_ack_freq) {
+        if (delayed_ack_event == NULL) {
+            delayed_ack_event = new DelayedAckEvent(get_current_time() + params.delayed_ack_timeout, this);
+            add_to_event_queue(delayed_ack_event);
+        }
+        return;
+    }
+    send_ack(recv_till, sack_list);
+    delayed_acks = 0;
+    cancel_delayed_ack();
+}
+
+// acks what has arrived in order so far
+void Flow::send_delayed_ack() {
+    std::vector<uint32_t> sack_list;
+    send_ack(recv_till, sack_list);
+    delayed_acks = 0;
+    cancel_delayed_ack();
+}
+
+void Flow::cancel_delayed_ack() {
+    if (delayed_ack_event) {
+        delayed_ack_event->cancelled = true;
+    }
+    delayed_ack_event = NULL;
 }
 
 void Flow::set_timeout(double time) {
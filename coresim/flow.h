@@ -2,6 +2,7 @@
 #define FLOW_H
 
 #include <unordered_map>
+#include <vector>
 #include "node.h"
 
 class Packet;
@@ -9,12 +10,13 @@ class Ack;
 class Probe;
 class RetxTimeoutEvent;
 class FlowProcessingEvent;
+class DelayedAckEvent;
 
 class Flow {
     public:
         Flow(uint32_t id, double start_time, uint32_t size, Host *s, Host *d);
 
-        ~Flow(); // Destructor
+        virtual ~Flow(); // Destructor
 
         virtual void start_flow();
         virtual void send_pending_data();
@@ -23,6 +25,14 @@ class Flow {
         virtual void receive_ack(uint32_t ack, std::vector<uint32_t> sack_list);
         void receive_data_pkt(Packet* p);
         virtual void receive(Packet *p);
+        void mark_receipt(Packet *p);
+        void ack_data(bool in_order, std::vector<uint32_t> &sack_list);
+        void send_delayed_ack();
+        void cancel_delayed_ack();
+        bool has_received(uint32_t seq) const {
+            uint32_t i = seq / mss;
+            return i < received.size() && received[i];
+        }
         
         // Only sets the timeout if needed; i.e., flow hasn't finished
         virtual void set_timeout(double time);
@@ -33,51 +43,63 @@ class Flow {
         virtual void increase_cwnd();
         virtual double get_avg_queuing_delay_in_us();
 
+        // Hot sender state, read on every send and every ack.
         uint32_t id;
-        double start_time;
-        double finish_time;
         uint32_t size;
         Host *src;
         Host *dst;
+        uint32_t next_seq_no;
+        uint32_t last_unacked_seq;
         uint32_t cwnd_mss;
         uint32_t max_cwnd;
-        double retx_timeout;
         uint32_t mss;
         uint32_t hdr_size;
-
-        // Sender variables
-        uint32_t next_seq_no;
-        uint32_t last_unacked_seq;
         RetxTimeoutEvent *retx_event;
         FlowProcessingEvent *flow_proc_event;
+        double retx_timeout;
+        uint32_t total_pkt_sent;
+        int size_in_pkt;
+        // Sack
+        uint32_t scoreboard_sack_bytes;
+        bool finished;
+        // Checked or counted by PFabricQueue::deque for every data packet.
+        double first_byte_send_time;
+        int first_hop_departure;
+        int last_hop_departure;
+
+        // Packets and flow events pointing at this flow. With retire_flows a
+        // finished flow is freed once it has left flows_to_schedule and the
+        // last of these is gone.
+        void hold();
+        void release();
+        uint32_t refs;
+        bool retired;   // results copied into the result store
+        bool detached;  // no longer in flows_to_schedule
+        bool arrived;   // its FlowArrivalEvent has run
 
         //  std::unordered_map<uint32_t, Packet *> packets;
 
-        // Receiver variables
-        std::unordered_map<uint32_t, bool> received;
+        // Hot receiver state, read on every data packet.
+        std::vector<bool> received;     // by seq_no / mss
         uint32_t received_bytes;
         uint32_t recv_till;
         uint32_t max_seq_no_recv;
-
-        uint32_t total_pkt_sent;
-        int size_in_pkt;
-        int pkt_drop;
-        int data_pkt_drop;
-        int ack_pkt_drop;
-        int first_hop_departure;
-        int last_hop_departure;
         uint32_t received_count;
-        // Sack
-        uint32_t scoreboard_sack_bytes;
-        // finished variables
-        bool finished;
-        double flow_completion_time;
         double total_queuing_time;
-        double first_byte_send_time;
-        double first_byte_receive_time;
+        uint32_t delayed_acks;  // data packets received since the last ack
+        DelayedAckEvent *delayed_ack_event;
 
-        uint32_t flow_priority;
+        // Cold: scheduling inputs and statistics, touched at arrival,
+        // finish or on drops only.
+        double start_time;
+        double finish_time;
+        double flow_completion_time;
+        double first_byte_receive_time;
         double deadline;
+        uint32_t flow_priority;
+        int pkt_drop;
+        int data_pkt_drop;
+        int ack_pkt_drop;
 };
 
 #endif
@@ -5,6 +5,7 @@
 #include <deque>
 #include <stdint.h>
 #include <time.h>
+#include <chrono>
 #include "assert.h"
 
 #include "flow.h"
@@ -19,11 +20,14 @@
 //#include "../ext/fastpasshost.h"
 
 #include "../run/params.h"
+#include "../run/fingerprint.h"
 
 using namespace std;
 
 Topology* topology;
 double current_time = 0;
+uint64_t current_event_num = 0;     // events taken off the queue so far
+uint64_t passed_queue_processing = 0;   // last of them at current_time ordered after queue processing
 std::priority_queue<Event*, std::vector<Event*>, EventComparator> event_queue;
 std::deque<Flow*> flows_to_schedule;
 std::deque<Event*> flow_arrivals;
@@ -74,6 +78,37 @@ double get_current_time() {
     return current_time; // in us
 }
 
+/*
+ * end_time (simulated) and wall_clock_budget bound a run. Once either is
+ * reached no more flows arrive; flows already started get drain_time more
+ * simulated seconds, then the loop ends even if events are left.
+ */
+extern void stop_flow_arrivals();
+extern Fingerprint *fingerprint;
+bool run_limit_reached = false;
+double run_stopped_at = -1;
+double drain_until = -1;
+
+#define WALL_CLOCK_CHECK_EVENTS 65536
+
+void check_run_limits(uint64_t num_events, std::chrono::steady_clock::time_point wall_start) {
+    if (params.end_time > 0 && current_time - start_time > params.end_time) {
+        run_stopped_at = start_time + params.end_time;
+    }
+    else if (params.wall_clock_budget > 0 && num_events % WALL_CLOCK_CHECK_EVENTS == 0) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - wall_start;
+        if (elapsed.count() > params.wall_clock_budget) {
+            run_stopped_at = current_time;
+        }
+    }
+    if (run_stopped_at < 0) {
+        return;
+    }
+    run_limit_reached = true;
+    drain_until = run_stopped_at + params.drain_time;
+    stop_flow_arrivals();
+}
+
 /* Runs a initialized scenario */
 void run_scenario() {
     // Flow Arrivals create new flow arrivals
@@ -84,10 +119,19 @@ void run_scenario() {
     }
     int last_evt_type = -1;
     int same_evt_count = 0;
+    uint64_t num_events = 0;
+    auto wall_start = std::chrono::steady_clock::now();
     while (event_queue.size() > 0) {
         Event *ev = event_queue.top();
         event_queue.pop();
+        current_event_num++;
+        if (ev->time != current_time) {
+            passed_queue_processing = 0;
+        }
         current_time = ev->time;
+        if (ev->type > QUEUE_PROCESSING) {
+            passed_queue_processing = current_event_num;
+        }
         if (start_time < 0) {
             start_time = current_time;
         }
@@ -95,6 +139,23 @@ void run_scenario() {
             delete ev; //TODO: Smarter
             continue;
         }
+        if (!run_limit_reached) {
+            check_run_limits(++num_events, wall_start);
+        }
+        if (run_limit_reached) {
+            if (current_time > drain_until) {
+                delete ev;
+                break;
+            }
+            // the one arrival scheduled before the limit
+            if (ev->type == FLOW_ARRIVAL) {
+                delete ev;
+                continue;
+            }
+        }
+        if (fingerprint != NULL) {
+            fingerprint->add_event(ev);
+        }
         ev->process_event();
 
         if(last_evt_type == ev->type && last_evt_type != 9)
@@ -119,8 +180,6 @@ int main (int argc, char ** argv) {
     time_t start_time;
     time(&start_time);
 
-    //srand(time(NULL));
-    srand(0);
     std::cout.precision(15);
 
     uint32_t exp_type = atoi(argv[1]);
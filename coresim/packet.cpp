@@ -2,7 +2,7 @@
 #include "../run/params.h"
 
 extern DCExpParams params;
-uint32_t Packet::instance_count = 0;
+uint64_t Packet::instance_count = 0;
 
 Packet::Packet(
         double sending_time, 
@@ -24,6 +24,15 @@ Packet::Packet(
     this->type = NORMAL_PACKET;
     this->unique_id = Packet::instance_count++;
     this->total_queuing_delay = 0;
+    if (flow != NULL) {
+        flow->hold();
+    }
+}
+
+Packet::~Packet() {
+    if (flow != NULL) {
+        flow->release();
+    }
 }
 
 PlainAck::PlainAck(Flow *flow, uint32_t seq_no_acked, uint32_t size, Host* src, Host *dst) : Packet(0, flow, seq_no_acked, 0, size, src, dst) {
@@ -74,6 +83,21 @@ CapabilityPkt::CapabilityPkt(Flow *flow, Host *src, Host *dst, double ttl, int r
     this->data_seq_num = data_seq_num;
 }
 
+CapabilityDataPkt::CapabilityDataPkt(
+        double sending_time,
+        Flow *flow,
+        uint32_t seq_no,
+        uint32_t pf_priority,
+        uint32_t size,
+        Host *src,
+        Host *dst,
+        int capa_seq,
+        int data_seq
+    ) : Packet(sending_time, flow, seq_no, pf_priority, size, src, dst) {
+    this->capability_seq_num_in_data = capa_seq;
+    this->capa_data_seq = data_seq;
+}
+
 StatusPkt::StatusPkt(Flow *flow, Host *src, Host *dst, int num_flows_at_sender) : Packet(0, flow, 0, 0, params.hdr_size, src, dst) {
     this->type = STATUS_PACKET;
     this->num_flows_at_sender = num_flows_at_sender;
@@ -24,24 +24,22 @@ class Packet {
     public:
         Packet(double sending_time, Flow *flow, uint32_t seq_no, uint32_t pf_priority,
                 uint32_t size, Host *src, Host *dst);
+        virtual ~Packet();
 
-        double sending_time;
+        // touched at every hop; with the vtable pointer this is 64 bytes
         Flow *flow;
-        uint32_t seq_no;
-        uint32_t pf_priority;
-        uint32_t size;
         Host *src;
         Host *dst;
-        uint32_t unique_id;
-        static uint32_t instance_count;
-        int remaining_pkts_in_batch;
-        int capability_seq_num_in_data;
-
         uint32_t type; // Normal or Ack packet
+        uint32_t size;
+        uint32_t seq_no;
+        uint32_t pf_priority;
         double total_queuing_delay;
         double last_enque_time;
 
-        int capa_data_seq;
+        double sending_time;
+        uint64_t unique_id;
+        static uint64_t instance_count;
 };
 
 class PlainAck : public Packet {
@@ -98,6 +96,15 @@ class CapabilityPkt : public Packet{
         int data_seq_num;
 };
 
+// capability data packet; the capability fields only ride on these
+class CapabilityDataPkt : public Packet{
+    public:
+        CapabilityDataPkt(double sending_time, Flow *flow, uint32_t seq_no, uint32_t pf_priority,
+                uint32_t size, Host *src, Host *dst, int capa_seq, int data_seq);
+        int capability_seq_num_in_data;
+        int capa_data_seq;
+};
+
 class StatusPkt : public Packet{
     public:
         StatusPkt(Flow *flow, Host *src, Host *dst, int num_flows_at_sender);
@@ -6,14 +6,21 @@
 #include "queue.h"
 #include "packet.h"
 #include "event.h"
+#include "topology.h"
 #include "debug.h"
+#include "random_stream.h"
 
 #include "../run/params.h"
+#include "../run/packet_trace.h"
 
 extern double get_current_time(); // TODOm
 extern void add_to_event_queue(Event* ev);
 extern uint32_t dead_packets;
 extern DCExpParams params;
+extern Topology* topology;
+extern double current_time;
+extern uint64_t current_event_num;
+extern uint64_t passed_queue_processing;
 
 uint32_t Queue::instance_count = 0;
 
@@ -50,8 +57,14 @@ Queue::Queue(uint32_t id, double rate, uint32_t limit_bytes, int location) {
     this->b_arrivals = 0; this->b_departures = 0;
 
     this->pkt_drop = 0;
-    this->spray_counter=std::rand();
+    this->spray_counter = RandomStream(unique_id, RNG_QUEUE_SPRAY).next();
     this->packet_transmitting = NULL;
+
+    // preemption cancels the events of the packet being sent, which a
+    // train has already set up for the packets behind it
+    this->trains = params.packet_trains && !params.preemptive_queue;
+    this->in_train = false;
+    this->train_end = 0;
 }
 
 void Queue::set_src_dst(Node *src, Node *dst) {
@@ -59,12 +72,47 @@ void Queue::set_src_dst(Node *src, Node *dst) {
     this->dst = dst;
 }
 
+// a packet reaches the queue: start sending it if idle, preempting if allowed
+void Queue::accept(Packet *packet) {
+    if (trains) {
+        settle();
+        if (join_train(packet)) {
+            return;
+        }
+        split_train();
+    }
+
+    if (!busy) {
+        queue_proc_event = new QueueProcessingEvent(get_current_time(), this);
+        add_to_event_queue(queue_proc_event);
+        busy = true;
+        packet_transmitting = packet;
+    }
+    else if( params.preemptive_queue && packet->pf_priority < packet_transmitting->pf_priority) {
+        double remaining_percentage = (queue_proc_event->time - get_current_time()) / get_transmission_delay(packet_transmitting->size);
+
+        if(remaining_percentage > 0.01){
+            preempt_current_transmission();
+
+            queue_proc_event = new QueueProcessingEvent(get_current_time(), this);
+            add_to_event_queue(queue_proc_event);
+            busy = true;
+            packet_transmitting = packet;
+        }
+    }
+
+    enque(packet);
+}
+
 void Queue::enque(Packet *packet) {
     p_arrivals += 1;
     b_arrivals += packet->size;
     if (bytes_in_queue + packet->size <= limit_bytes) {
         packets.push_back(packet);
         bytes_in_queue += packet->size;
+        if (packet_trace != NULL) {
+            packet_trace->add(this, packet, PACKET_TRACE_ENQUEUE);
+        }
     } else {
         pkt_drop++;
         drop(packet);
@@ -78,12 +126,18 @@ Packet *Queue::deque() {
         bytes_in_queue -= p->size;
         p_departures += 1;
         b_departures += p->size;
+        if (packet_trace != NULL) {
+            packet_trace->add(this, p, PACKET_TRACE_DEQUEUE);
+        }
         return p;
     }
     return NULL;
 }
 
 void Queue::drop(Packet *packet) {
+    if (packet_trace != NULL) {
+        packet_trace->add(this, packet, PACKET_TRACE_DROP);
+    }
     packet->flow->pkt_drop++;
     if(packet->seq_no < packet->flow->size){
         packet->flow->data_pkt_drop++;
@@ -107,6 +161,123 @@ double Queue::get_transmission_delay(uint32_t size) {
     return size * 8.0 / rate;
 }
 
+// the packet starts leaving at time: schedules its arrival at the next hop
+Event *Queue::transmit(Packet *packet, double time) {
+    Queue *next_hop = topology->get_next_hop(packet, this);
+    double td = get_transmission_delay(packet->size);
+    double pd = propagation_delay;
+    if (next_hop == NULL) {
+        PacketArrivalEvent *arrival_evt = new PacketArrivalEvent(time + td + pd, packet);
+        arrival_evt->upstream = in_train ? this : NULL;
+        add_to_event_queue(arrival_evt);
+        return arrival_evt;
+    }
+
+    PacketQueuingEvent *queuing_evt = NULL;
+    if (params.cut_through == 1) {
+        double cut_through_delay = get_transmission_delay(packet->flow->hdr_size);
+        queuing_evt = new PacketQueuingEvent(time + cut_through_delay + pd, packet, next_hop);
+    } else {
+        queuing_evt = new PacketQueuingEvent(time + td + pd, packet, next_hop);
+    }
+    queuing_evt->upstream = in_train ? this : NULL;
+    add_to_event_queue(queuing_evt);
+    return queuing_evt;
+}
+
+double Queue::transmission_end() {
+    if (in_train) {
+        return train.empty() ? train_end : train.front().time;
+    }
+    return queue_proc_event->time;
+}
+
+/*
+ * Packet trains. While a queue holds packets of one flow only and nothing
+ * is dropped, the time each packet starts to leave is known when it
+ * arrives: right after the packets ahead of it, back to back. Such packets
+ * are sent at once, without the QueueProcessingEvent per packet; the queue
+ * keeps them, in train, until settle() dequeues them at their departure
+ * times. A packet of another flow, or one that would be dropped, splits the
+ * train: the packets not yet sent have their events cancelled and go back
+ * to a QueueProcessingEvent at the end of the current transmission.
+ *
+ * Departures are settled in the order the per packet events would have
+ * run, and events made ahead keep their place among same time events (see
+ * EventComparator), so results are the same as with packet_trains: 0.
+ */
+
+// whether a QueueProcessingEvent at time, made during event made_at, would
+// have run by now: at the current time, that is once an event ordered after
+// it has been taken off the event queue
+static bool departed_by_now(double time, uint64_t made_at) {
+    if (time == current_time) {
+        return passed_queue_processing > made_at;
+    }
+    return time < current_time;
+}
+
+bool Queue::join_train(Packet *packet) {
+    if (busy && !in_train) {
+        return false;
+    }
+    if (!packets.empty() && packets.front()->flow != packet->flow) {
+        return false;
+    }
+    if (bytes_in_queue + packet->size > limit_bytes) {
+        return false;
+    }
+
+    TrainDeparture d;
+    d.packet = packet;
+    d.time = in_train ? train_end : get_current_time();
+    d.made_at = in_train ? 0 : current_event_num;
+    d.spray_counter = spray_counter;
+    if (!in_train) {
+        in_train = true;
+        busy = true;
+        packet_transmitting = packet;
+    }
+    enque(packet);
+    d.next_event = transmit(packet, d.time);
+    train.push_back(d);
+    train_end = d.time + get_transmission_delay(packet->size);
+    return true;
+}
+
+void Queue::settle_train() {
+    while (!train.empty() && departed_by_now(train.front().time, train.front().made_at)) {
+        double now = current_time;
+        current_time = train.front().time;
+        Packet *p = deque();
+        current_time = now;
+        assert(p == train.front().packet);
+        packet_transmitting = p;
+        train.pop_front();
+    }
+    if (train.empty() && departed_by_now(train_end, 0)) {
+        in_train = false;
+        busy = false;
+        packet_transmitting = NULL;
+    }
+}
+
+void Queue::split_train() {
+    if (!in_train) {
+        return;
+    }
+    if (!train.empty()) {
+        spray_counter = train.front().spray_counter;
+    }
+    for (uint32_t i = 0; i < train.size(); i++) {
+        train[i].next_event->cancelled = true;
+    }
+    queue_proc_event = new QueueProcessingEvent(transmission_end(), this);
+    add_to_event_queue(queue_proc_event);
+    train.clear();
+    in_train = false;
+}
+
 void Queue::preempt_current_transmission() {
     if(params.preemptive_queue && busy){
         this->queue_proc_event->cancelled = true;
@@ -142,6 +313,8 @@ ProbDropQueue::ProbDropQueue(uint32_t id, double rate, uint32_t limit_bytes,
         double drop_prob, int location)
     : Queue(id, rate, limit_bytes, location) {
         this->drop_prob = drop_prob;
+        this->drop_rng.set_stream(unique_id, RNG_QUEUE_DROP);
+        this->trains = false;   // enque may drop what join_train counts on
     }
 
 void ProbDropQueue::enque(Packet *packet) {
@@ -149,12 +322,18 @@ void ProbDropQueue::enque(Packet *packet) {
     b_arrivals += packet->size;
 
     if (bytes_in_queue + packet->size <= limit_bytes) {
-        double r = (1.0 * rand()) / (1.0 * RAND_MAX);
+        double r = drop_rng.uniform();
         if (r < drop_prob) {
+            if (packet_trace != NULL) {
+                packet_trace->add(this, packet, PACKET_TRACE_DROP);
+            }
             return;
         }
         packets.push_back(packet);
         bytes_in_queue += packet->size;
+        if (packet_trace != NULL) {
+            packet_trace->add(this, packet, PACKET_TRACE_ENQUEUE);
+        }
         if (!busy) {
             add_to_event_queue(new QueueProcessingEvent(get_current_time(), this));
             this->busy = true;
@@ -5,6 +5,8 @@
 #include <stdint.h>
 #include <vector>
 
+#include "random_stream.h"
+
 #define DROPTAIL_QUEUE 1
 
 class Node;
@@ -14,15 +16,35 @@ class Event;
 class QueueProcessingEvent;
 class PacketPropagationEvent;
 
+// a packet of a train: when it starts to leave and what it set up downstream
+struct TrainDeparture {
+    Packet *packet;
+    double time;
+    uint64_t made_at;           // event that would have made its QueueProcessingEvent, 0 if earlier
+    Event *next_event;          // its PacketQueuingEvent or PacketArrivalEvent
+    uint64_t spray_counter;     // before its next hop was picked
+};
+
 class Queue {
     public:
         Queue(uint32_t id, double rate, uint32_t limit_bytes, int location);
         void set_src_dst(Node *src, Node *dst);
+        void accept(Packet *packet);
         virtual void enque(Packet *packet);
         virtual Packet *deque();
         virtual void drop(Packet *packet);
         double get_transmission_delay(uint32_t size);
         void preempt_current_transmission();
+        Event *transmit(Packet *packet, double time);
+
+        // brings a train up to the current event; call before reading
+        // busy, bytes_in_queue or packets
+        void settle() {
+            if (in_train) {
+                settle_train();
+            }
+        }
+        double transmission_end();  // when the packet being sent is done
 
         // Members
         uint32_t id;
@@ -51,6 +73,16 @@ class Queue {
         uint64_t spray_counter;
 
         int location;
+
+        bool trains;
+        bool in_train;
+        std::deque<TrainDeparture> train;   // sent ahead, not yet dequeued
+        double train_end;
+
+    private:
+        bool join_train(Packet *packet);
+        void settle_train();
+        void split_train();
 };
 
 
@@ -66,6 +98,7 @@ class ProbDropQueue : public Queue {
         virtual void enque(Packet *packet);
 
         double drop_prob;
+        RandomStream drop_rng;
 };
 
 #endif
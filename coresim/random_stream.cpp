@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RNG_HAVE_AVX2_KERNELS
+#endif
+
+#include "random_stream.h"
+
+#include "../run/params.h"
+
+extern DCExpParams params;
+
+#define PHILOX_M0 0xD2511F53
+#define PHILOX_M1 0xCD9E8D57
+#define PHILOX_W0 0x9E3779B9
+#define PHILOX_W1 0xBB67AE85
+#define PHILOX_ROUNDS 10
+
+RandomStream::RandomStream() {
+    set_stream(0, RNG_UNIFORM);
+}
+
+RandomStream::RandomStream(uint32_t id, uint32_t purpose) {
+    set_stream(id, purpose);
+}
+
+void RandomStream::set_stream(uint32_t id, uint32_t purpose) {
+    key[0] = params.seed;
+    key[1] = purpose;
+    counter[0] = 0;
+    counter[1] = 0;
+    counter[2] = id;
+    counter[3] = 0;
+    used = 4;
+}
+
+void RandomStream::refill() {
+    philox(block);
+    used = 0;
+}
+
+/* One Philox block for the current counter, then advances the counter. */
+void RandomStream::philox(uint32_t *out) {
+    uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+    uint32_t k0 = key[0], k1 = key[1];
+    for (int r = 0; r < PHILOX_ROUNDS; r++) {
+        uint64_t p0 = (uint64_t) PHILOX_M0 * c0;
+        uint64_t p1 = (uint64_t) PHILOX_M1 * c2;
+        uint32_t n0 = (uint32_t) (p1 >> 32) ^ c1 ^ k0;
+        uint32_t n2 = (uint32_t) (p0 >> 32) ^ c3 ^ k1;
+        c0 = n0;
+        c1 = (uint32_t) p1;
+        c2 = n2;
+        c3 = (uint32_t) p0;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+
+    if (++counter[0] == 0) {
+        counter[1]++;
+    }
+}
+
+/*
+ * Drains what is left of the current block, writes whole blocks straight into
+ * out, and keeps the tail of the last block for later next() calls.
+ */
+void RandomStream::fill(uint32_t *out, uint32_t n) {
+    uint32_t i = 0;
+    while (i < n && used < 4) {
+        out[i++] = block[used++];
+    }
+    for (; i + 4 <= n; i += 4) {
+        philox(out + i);
+    }
+    while (i < n) {
+        out[i++] = next();
+    }
+}
+
+/*
+ * Kernels behind fill_uniform() and fill_exponential(). The AVX2 ones do the
+ * same IEEE operations in the same order as the plain ones, four lanes at a
+ * time, so which one runs never changes a draw. log is fdlibm's: reduce to
+ * 2^k * m with m in [sqrt(2)/2, sqrt(2)) and a degree 14 polynomial in
+ * s = (m-1)/(m+1), good to about 1 ulp. It is not libm's log, whose last bit
+ * differs from build to build.
+ */
+#define LOG_LN2_HI 6.93147180369123816490e-01
+#define LOG_LN2_LO 1.90821492927058770002e-10
+#define LOG_SQRT2 1.41421356237309504880
+#define LOG_LG1 6.666666666666735130e-01
+#define LOG_LG2 3.999999999940941908e-01
+#define LOG_LG3 2.857142874366239149e-01
+#define LOG_LG4 2.222219843214978396e-01
+#define LOG_LG5 1.818357216161805012e-01
+#define LOG_LG6 1.531383769920937332e-01
+#define LOG_LG7 1.479819860511658591e-01
+#define LOG_EXP_MASK 0x7ff0000000000000ULL
+#define LOG_ONE_BITS 0x3ff0000000000000ULL
+#define LOG_DOUBLE_MAGIC 6755399441055744.0    // 1.5 * 2^52
+
+// -log(x) for normal x > 0
+static inline double neg_log(double x) {
+    uint64_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    double k = (double) ((int64_t) (bits >> 52) - 1023);
+    bits = (bits & ~LOG_EXP_MASK) | LOG_ONE_BITS;
+    double m;
+    memcpy(&m, &bits, sizeof(m));
+    if (m > LOG_SQRT2) {
+        m = m * 0.5;
+        k = k + 1.0;
+    }
+    double f = m - 1.0;
+    double s = f / (2.0 + f);
+    double z = s * s;
+    double w = z * z;
+    double t1 = w * (LOG_LG2 + w * (LOG_LG4 + w * LOG_LG6));
+    double t2 = z * (LOG_LG1 + w * (LOG_LG3 + w * (LOG_LG5 + w * LOG_LG7)));
+    double r = t2 + t1;
+    double hfsq = 0.5 * f * f;
+    return ((hfsq - (s * (hfsq + r) + k * LOG_LN2_LO)) - f) - k * LOG_LN2_HI;
+}
+
+static void uniform_kernel(const uint32_t *bits, double *out, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        out[i] = (bits[i] + 0.5) * (1.0 / 4294967296.0);
+    }
+}
+
+static void exponential_kernel(const uint32_t *bits, double *out, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        out[i] = neg_log((bits[i] + 0.5) * (1.0 / 4294967296.0));
+    }
+}
+
+#ifdef RNG_HAVE_AVX2_KERNELS
+// bits[i] + 0.5 for four lanes: as signed after flipping the top bit, then back
+__attribute__((target("avx2")))
+static inline __m256d uniform_avx2(const uint32_t *bits) {
+    __m128i b = _mm_loadu_si128((const __m128i *) bits);
+    __m256d d = _mm256_cvtepi32_pd(_mm_xor_si128(b, _mm_set1_epi32(0x80000000)));
+    d = _mm256_add_pd(d, _mm256_set1_pd(2147483648.5));
+    return _mm256_mul_pd(d, _mm256_set1_pd(1.0 / 4294967296.0));
+}
+
+__attribute__((target("avx2")))
+static inline __m256d neg_log_avx2(__m256d x) {
+    __m256i bits = _mm256_castpd_si256(x);
+    // k is small, so adding it to the bits of 1.5 * 2^52 and taking the
+    // double back off converts it exactly
+    __m256i e = _mm256_sub_epi64(_mm256_srli_epi64(bits, 52), _mm256_set1_epi64x(1023));
+    __m256d magic = _mm256_set1_pd(LOG_DOUBLE_MAGIC);
+    __m256d k = _mm256_sub_pd(
+        _mm256_castsi256_pd(_mm256_add_epi64(e, _mm256_castpd_si256(magic))), magic);
+    bits = _mm256_or_si256(_mm256_andnot_si256(_mm256_set1_epi64x(LOG_EXP_MASK), bits),
+        _mm256_set1_epi64x(LOG_ONE_BITS));
+    __m256d m = _mm256_castsi256_pd(bits);
+    __m256d big = _mm256_cmp_pd(m, _mm256_set1_pd(LOG_SQRT2), _CMP_GT_OQ);
+    m = _mm256_blendv_pd(m, _mm256_mul_pd(m, _mm256_set1_pd(0.5)), big);
+    k = _mm256_blendv_pd(k, _mm256_add_pd(k, _mm256_set1_pd(1.0)), big);
+
+    __m256d f = _mm256_sub_pd(m, _mm256_set1_pd(1.0));
+    __m256d s = _mm256_div_pd(f, _mm256_add_pd(_mm256_set1_pd(2.0), f));
+    __m256d z = _mm256_mul_pd(s, s);
+    __m256d w = _mm256_mul_pd(z, z);
+    __m256d t1 = _mm256_mul_pd(w, _mm256_add_pd(_mm256_set1_pd(LOG_LG2),
+        _mm256_mul_pd(w, _mm256_add_pd(_mm256_set1_pd(LOG_LG4),
+        _mm256_mul_pd(w, _mm256_set1_pd(LOG_LG6))))));
+    __m256d t2 = _mm256_mul_pd(z, _mm256_add_pd(_mm256_set1_pd(LOG_LG1),
+        _mm256_mul_pd(w, _mm256_add_pd(_mm256_set1_pd(LOG_LG3),
+        _mm256_mul_pd(w, _mm256_add_pd(_mm256_set1_pd(LOG_LG5),
+        _mm256_mul_pd(w, _mm256_set1_pd(LOG_LG7))))))));
+    __m256d r = _mm256_add_pd(t2, t1);
+    __m256d hfsq = _mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(0.5), f), f);
+    __m256d inner = _mm256_add_pd(_mm256_mul_pd(s, _mm256_add_pd(hfsq, r)),
+        _mm256_mul_pd(k, _mm256_set1_pd(LOG_LN2_LO)));
+    return _mm256_sub_pd(_mm256_sub_pd(_mm256_sub_pd(hfsq, inner), f),
+        _mm256_mul_pd(k, _mm256_set1_pd(LOG_LN2_HI)));
+}
+
+__attribute__((target("avx2")))
+static void uniform_kernel_avx2(const uint32_t *bits, double *out, uint32_t n) {
+    uint32_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(out + i, uniform_avx2(bits + i));
+    }
+    uniform_kernel(bits + i, out + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void exponential_kernel_avx2(const uint32_t *bits, double *out, uint32_t n) {
+    uint32_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(out + i, neg_log_avx2(uniform_avx2(bits + i)));
+    }
+    exponential_kernel(bits + i, out + i, n - i);
+}
+
+static bool cpu_has_avx2() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+bool rng_avx2 = cpu_has_avx2();
+#else
+bool rng_avx2 = false;
+#endif
+
+void RandomStream::fill_uniform(double *out, uint32_t n) {
+    uint32_t bits[64];
+    for (uint32_t i = 0; i < n; i += 64) {
+        uint32_t m = std::min(n - i, (uint32_t) 64);
+        fill(bits, m);
+#ifdef RNG_HAVE_AVX2_KERNELS
+        if (rng_avx2) {
+            uniform_kernel_avx2(bits, out + i, m);
+            continue;
+        }
+#endif
+        uniform_kernel(bits, out + i, m);
+    }
+}
+
+void RandomStream::fill_exponential(double *out, uint32_t n) {
+    uint32_t bits[64];
+    for (uint32_t i = 0; i < n; i += 64) {
+        uint32_t m = std::min(n - i, (uint32_t) 64);
+        fill(bits, m);
+#ifdef RNG_HAVE_AVX2_KERNELS
+        if (rng_avx2) {
+            exponential_kernel_avx2(bits, out + i, m);
+            continue;
+        }
+#endif
+        exponential_kernel(bits, out + i, m);
+    }
+}
+
+double RandomStream::exponential() {
+    return neg_log(uniform());
+}
@@ -0,0 +1,75 @@
+#ifndef RANDOM_STREAM_H
+#define RANDOM_STREAM_H
+
+#include <stdint.h>
+
+// What a stream is drawn for. Together with the config seed and an id
+// (host, queue or generator slot) this selects an independent stream.
+#define RNG_UNIFORM 0
+#define RNG_FLOW_SIZE 1
+#define RNG_INTERARRIVAL 2
+#define RNG_HOST_PICK 3
+#define RNG_TRAFFIC_MATRIX 4
+#define RNG_DEADLINE 5
+#define RNG_QUEUE_SPRAY 6
+#define RNG_QUEUE_DROP 7
+#define RNG_CAPABILITY 8
+
+// Ids from here up are handed out, one per instance, to random variables
+// nobody picked a stream for; explicit ids (hosts, queues) stay below it.
+#define RNG_DEFAULT_ID_BASE 0x80000000
+
+/*
+Counter-based generator (Philox4x32-10). The key is (seed, purpose) and the
+counter is (block index, id), so every (seed, id, purpose) triple is its own
+stream and draws never depend on what other streams consumed, or in which
+order, or on which thread.
+*/
+class RandomStream {
+public:
+    RandomStream();
+    RandomStream(uint32_t id, uint32_t purpose);
+    void set_stream(uint32_t id, uint32_t purpose);
+
+    // 32 uniformly random bits
+    uint32_t next() {
+        if (used == 4) {
+            refill();
+        }
+        return block[used++];
+    }
+
+    // uniform in the open interval (0, 1)
+    double uniform() {
+        return (next() + 0.5) * (1.0 / 4294967296.0);
+    }
+
+    // uniform in [0, n)
+    uint32_t below(uint32_t n) {
+        return (uint32_t) (((uint64_t) next() * n) >> 32);
+    }
+
+    // unit exponential, -log(uniform()) with the simulator's own log
+    double exponential();
+
+    // n draws at once; same values as n calls to next() / uniform() /
+    // exponential()
+    void fill(uint32_t *out, uint32_t n);
+    void fill_uniform(double *out, uint32_t n);
+    void fill_exponential(double *out, uint32_t n);
+
+private:
+    void refill();
+    void philox(uint32_t *out);
+
+    uint32_t key[2];
+    uint32_t counter[4];
+    uint32_t block[4];
+    uint32_t used;
+};
+
+// fill_uniform() and fill_exponential() use AVX2 kernels when set; it starts
+// out as whether the CPU has AVX2. Either way the draws are the same.
+extern bool rng_avx2;
+
+#endif
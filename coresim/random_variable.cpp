@@ -12,36 +12,90 @@
 
 using namespace std;
 
+/* Fills out[0..n) with samples; subclasses may override with a cheaper batch path.
+ */
+void RandomVariable::fill(double* out, uint32_t n) {
+  for (uint32_t i = 0; i < n; i++) {
+    out[i] = value();
+  }
+}
+
+uint32_t RandomVariable::next_default_id = RNG_DEFAULT_ID_BASE;
+
+/* Picks the stream draws come from. Each instance starts on a stream of its
+ * own for its usual purpose; callers that want draws independent of how many
+ * variables were made before (per host streams, say) pick the id themselves.
+ */
+void RandomVariable::set_stream(uint32_t id, uint32_t purpose) {
+  rng.set_stream(id, purpose);
+}
+
+void RandomVariable::set_default_stream(uint32_t purpose) {
+  set_stream(next_default_id++, purpose);
+}
+
 /* Uniform Random Variable
 */
 UniformRandomVariable::UniformRandomVariable() {
   min_ = 0.0;
   max_ = 1.0;
+  set_default_stream(RNG_UNIFORM);
 }
 
 UniformRandomVariable::UniformRandomVariable(double min, double max) {
   min_ = min;
   max_ = max;
+  set_default_stream(RNG_UNIFORM);
 }
 
 double UniformRandomVariable::value() { // never return 0
-  //double unif0_1 = (1.0 * rand() + 1.0) / (RAND_MAX* 1.0 + 1.0);
-  double unif0_1 = (1.0 * rand()) / (RAND_MAX * 1.0);
+  double unif0_1 = rng.uniform();
   return min_ + (max_ - min_) * unif0_1;
 }
 
+void UniformRandomVariable::fill(double* out, uint32_t n) {
+  rng.fill_uniform(out, n);
+  for (uint32_t i = 0; i < n; i++) {
+    out[i] = min_ + (max_ - min_) * out[i];
+  }
+}
+
 
 
 /* Exponential Random Variable
  */
 ExponentialRandomVariable::ExponentialRandomVariable(double avg) {
   avg_ = avg;
-  urv = UniformRandomVariable();
-
+  set_default_stream(RNG_INTERARRIVAL);
 }
 
 double ExponentialRandomVariable::value() {
-  return -1.0 * avg_ * log(urv.value());
+  if (batch_pos_ == EXP_BATCH_SIZE) {
+    sample_unit(batch_, EXP_BATCH_SIZE);
+    batch_pos_ = 0;
+  }
+  return avg_ * batch_[batch_pos_++];
+}
+
+// hands out whatever is left in batch_ first so value() and fill() interleave
+void ExponentialRandomVariable::fill(double* out, uint32_t n) {
+  uint32_t i = 0;
+  while (i < n && batch_pos_ < EXP_BATCH_SIZE) {
+    out[i++] = avg_ * batch_[batch_pos_++];
+  }
+  sample_unit(out + i, n - i);
+  for (; i < n; i++) {
+    out[i] *= avg_;
+  }
+}
+
+void ExponentialRandomVariable::set_stream(uint32_t id, uint32_t purpose) {
+  RandomVariable::set_stream(id, purpose);
+  batch_pos_ = EXP_BATCH_SIZE;
+}
+
+void ExponentialRandomVariable::sample_unit(double* out, uint32_t n) {
+  rng.fill_exponential(out, n);
 }
 
 
@@ -54,7 +108,9 @@ EmpiricalRandomVariable::EmpiricalRandomVariable(std::string filename, bool smoo
   this->smooth = smooth;
   minCDF_ = 0;
   maxCDF_ = 1;
+  numEntry_ = 0;
   maxEntry_ = 65536;
+  set_default_stream(RNG_FLOW_SIZE);
   table_ = new CDFentry[maxEntry_];
   if(filename != "")
       loadCDF(filename);
@@ -63,7 +119,7 @@ EmpiricalRandomVariable::EmpiricalRandomVariable(std::string filename, bool smoo
 double EmpiricalRandomVariable::value() {
   if (numEntry_ <= 0)
     return 0;
-  double u = (1.0 * rand()) / RAND_MAX;
+  double u = rng.uniform();
   int mid = lookup(u);
   if (mid && u < table_[mid].cdf_)
     return interpolate(u, table_[mid-1].cdf_, table_[mid-1].val_,
@@ -71,14 +127,45 @@ double EmpiricalRandomVariable::value() {
   return table_[mid].val_;
 }
 
+/* Copy that shares the CDF table with this one, on a stream of its own.
+ */
+EmpiricalRandomVariable *EmpiricalRandomVariable::clone() {
+  EmpiricalRandomVariable *c = new EmpiricalRandomVariable(*this);
+  c->set_default_stream(RNG_FLOW_SIZE);
+  return c;
+}
+
 double EmpiricalRandomVariable::interpolate(double x, double x1, double y1,
                                             double x2, double y2) {
   double value = y1 + (x - x1) * (y2 - y1) / (x2 - x1);
   return value;
 }
 
+/* Uniform grid over [0, 1] holding the search() result at each cell boundary.
+ * A lookup starts from its cell and walks the few entries in between, which
+ * gives the same index as the binary search in O(1) expected time.
+ */
+void EmpiricalRandomVariable::build_lookup_grid() {
+  int grid_size = 4 * numEntry_;
+  lookup_grid_.resize(grid_size + 1);
+  for (int k = 0; k <= grid_size; k++) {
+    lookup_grid_[k] = search((double) k / grid_size);
+  }
+}
+
 int EmpiricalRandomVariable::lookup(double u) {
   // always return an index whose value is >= u
+  int grid_size = lookup_grid_.size() - 1;
+  int i = lookup_grid_[(int) (u * grid_size)];
+  // rounding in u * grid_size can land one cell high
+  while (i > 0 && u <= table_[i-1].cdf_)
+    i--;
+  while (i < numEntry_ - 1 && u > table_[i].cdf_)
+    i++;
+  return i;
+}
+
+int EmpiricalRandomVariable::search(double u) {
   int lo, hi, mid;
   if (u <= table_[0].cdf_)
     return 0;
@@ -117,6 +204,7 @@ int EmpiricalRandomVariable::loadCDF(std::string filename) {
     numEntry_ ++;
   }
   this->mean_flow_size = w_sum * 1460.0;
+  build_lookup_grid();
   //std::cout << "Mean flow size derived from CDF file:" << this->mean_flow_size << " smooth = " << this->smooth << "\n";
   //std::cout << "Number of lines in text file: " << numEntry_ << "\n";
   if (myfile.is_open()) {
@@ -131,6 +219,12 @@ EmpiricalBytesRandomVariable::EmpiricalBytesRandomVariable(std::string filename,
       loadCDF(filename);
 }
 
+EmpiricalRandomVariable *EmpiricalBytesRandomVariable::clone() {
+  EmpiricalBytesRandomVariable *c = new EmpiricalBytesRandomVariable(*this);
+  c->set_default_stream(RNG_FLOW_SIZE);
+  return c;
+}
+
 int EmpiricalBytesRandomVariable::loadCDF(std::string filename) {
   std::string line;
   std::ifstream myfile(filename);
@@ -158,6 +252,7 @@ int EmpiricalBytesRandomVariable::loadCDF(std::string filename) {
     numEntry_ ++;
   }
   this->mean_flow_size = w_sum;
+  build_lookup_grid();
   if (myfile.is_open()) {
     myfile.close();
   }
@@ -182,25 +277,38 @@ int NAryRandomVariable::loadSizes(std::string filename) {
   return this->flowSizes.size();
 }
 
+EmpiricalRandomVariable *NAryRandomVariable::clone() {
+  NAryRandomVariable *c = new NAryRandomVariable(*this);
+  c->set_default_stream(RNG_FLOW_SIZE);
+  return c;
+}
+
 double NAryRandomVariable::value() {
-  return this->flowSizes[rand() % this->flowSizes.size()];
+  return this->flowSizes[rng.below(this->flowSizes.size())];
 }
 
 CDFRandomVariable::CDFRandomVariable(std::string filename)
- : EmpiricalRandomVariable(filename, false) {}
-
-double CDFRandomVariable::value() {
-  double val = static_cast <double> (rand()) / static_cast <double> (RAND_MAX);
-//  std::cout << "randval " << val << " ";
+ : EmpiricalRandomVariable(filename, false) {
+  // entry i is returned for u in (cdf[i-1], cdf[i]]; anything above the
+  // last cdf value falls back to the last entry
+  std::vector<double> mass(numEntry_);
+  double prev_cdf = 0;
   for (int i = 0; i < numEntry_; i++) {
-  //  std::cout << " cdf " << table_[i].cdf_ << " " << table_[i].val_ << " ";
-    if (val <= table_[i].cdf_) {
-    //  std::cout << " found\n";
-      return table_[i].val_;
-    }
+    mass[i] = std::max(0.0, table_[i].cdf_ - prev_cdf);
+    prev_cdf = std::max(prev_cdf, table_[i].cdf_);
   }
-//  std::cout << " notfound " << table_[numEntry_-1].cdf_ << " " << table_[numEntry_-1].val_ << "\n";
-  return table_[numEntry_-1].val_;
+  mass[numEntry_-1] += std::max(0.0, 1.0 - prev_cdf);
+  alias_ = new AliasRandomVariable(mass);
+}
+
+EmpiricalRandomVariable *CDFRandomVariable::clone() {
+  CDFRandomVariable *c = new CDFRandomVariable(*this);
+  c->set_default_stream(RNG_FLOW_SIZE);
+  return c;
+}
+
+double CDFRandomVariable::value() {
+  return table_[alias_->sample(rng.uniform())].val_;
 }
 
 
@@ -214,13 +322,85 @@ double ConstantVariable::value()
     return v;
 }
 
+EmpiricalRandomVariable *ConstantVariable::clone()
+{
+    return new ConstantVariable(*this);
+}
+
+/* Alias Random Variable
+ * Vose's construction: every column holds at most two outcomes, so a sample
+ * costs one uniform draw and one comparison.
+ */
+AliasRandomVariable::AliasRandomVariable(const std::vector<double>& weights) {
+  uint32_t n = weights.size();
+  assert(n > 0);
+  set_default_stream(RNG_HOST_PICK);
+  prob_.resize(n);
+  alias_.resize(n);
+
+  double total = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    assert(weights[i] >= 0);
+    total += weights[i];
+  }
+  assert(total > 0);
+
+  std::vector<double> scaled(n);
+  std::vector<uint32_t> small, large;
+  for (uint32_t i = 0; i < n; i++) {
+    scaled[i] = weights[i] * n / total;
+    if (scaled[i] < 1.0)
+      small.push_back(i);
+    else
+      large.push_back(i);
+  }
+  while (!small.empty() && !large.empty()) {
+    uint32_t s = small.back();
+    small.pop_back();
+    uint32_t l = large.back();
+    prob_[s] = scaled[s];
+    alias_[s] = l;
+    scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+    if (scaled[l] < 1.0) {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+  // leftovers are 1 up to rounding
+  for (uint32_t i = 0; i < large.size(); i++) {
+    prob_[large[i]] = 1.0;
+    alias_[large[i]] = large[i];
+  }
+  for (uint32_t i = 0; i < small.size(); i++) {
+    prob_[small[i]] = 1.0;
+    alias_[small[i]] = small[i];
+  }
+}
+
+uint32_t AliasRandomVariable::sample() {
+  return sample(rng.uniform());
+}
+
+// u in [0, 1) picks the column and the coin flip within it
+uint32_t AliasRandomVariable::sample(double u) {
+  u *= prob_.size();
+  uint32_t column = (uint32_t) u;
+  return (u - column < prob_[column]) ? column : alias_[column];
+}
+
+double AliasRandomVariable::value() {
+  return sample();
+}
+
 GaussianRandomVariable::GaussianRandomVariable(double avg, double std) {
   this->avg = avg;
   this->std = std;
-
-  distribution = new std::normal_distribution<double>(avg,std);
+  set_default_stream(RNG_TRAFFIC_MATRIX);
 }
 
+// Box-Muller; uniform() is never 0, so the log is finite
 double GaussianRandomVariable::value() {
-  return (*distribution)(generator);
+  double u1 = rng.uniform();
+  double u2 = rng.uniform();
+  return avg + std * sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
 }
@@ -1,17 +1,28 @@
 #ifndef RANDOM_VARIABLE_H
 #define RANDOM_VARIABLE_H
 
+#include <stdint.h>
 #include <vector>
-#include <random>
+
+#include "random_stream.h"
 
 class RandomVariable {
 public:
     virtual double value() = 0;
+    virtual void fill(double* out, uint32_t n);
+    virtual void set_stream(uint32_t id, uint32_t purpose);
+
+protected:
+    void set_default_stream(uint32_t purpose);
+
+    RandomStream rng;
+    static uint32_t next_default_id;
 };
 
 class UniformRandomVariable : public RandomVariable {
 public:
   virtual double value();
+  virtual void fill(double* out, uint32_t n);
   UniformRandomVariable();
   UniformRandomVariable(double min, double max);
   double min_;
@@ -19,12 +30,25 @@ public:
 };
 
 
+#define EXP_BATCH_SIZE 64
+
+/*
+Draws unit exponentials EXP_BATCH_SIZE at a time into batch_ and scales them
+by avg_ on the way out, so value() is a buffer read most of the time.
+*/
 class ExponentialRandomVariable : public RandomVariable {
 public:
   virtual double value();
+  virtual void fill(double* out, uint32_t n);
+  virtual void set_stream(uint32_t id, uint32_t purpose);
   ExponentialRandomVariable(double avg);
   double avg_;
-  UniformRandomVariable urv;
+
+protected:
+  void sample_unit(double* out, uint32_t n);
+
+  double batch_[EXP_BATCH_SIZE];
+  uint32_t batch_pos_;
 };
 
 
@@ -43,6 +67,7 @@ public:
 
   EmpiricalRandomVariable(std::string filename, bool smooth = true);
   int loadCDF(std::string filename);
+  virtual EmpiricalRandomVariable *clone();
 
   double mean_flow_size;
 
@@ -50,12 +75,15 @@ public:
 
 protected:
   int lookup(double u);
+  int search(double u);
+  void build_lookup_grid();
 
   double minCDF_;		// min value of the CDF (default to 0)
   double maxCDF_;		// max value of the CDF (default to 1)
   int numEntry_;		// number of entries in the CDF table
   int maxEntry_;		// size of the CDF table (mem allocation)
   CDFentry* table_;	// CDF table of (val_, cdf_)
+  std::vector<int> lookup_grid_;	// lookup(k / grid size) for each grid cell
 };
 
 // READ VALUE IN BYTES
@@ -63,6 +91,7 @@ class EmpiricalBytesRandomVariable : public EmpiricalRandomVariable {
 public:
   EmpiricalBytesRandomVariable(std::string filename, bool smooth = true);
   int loadCDF(std::string filename);
+  virtual EmpiricalRandomVariable *clone();
   
   double sizeWithHeader;
 };
@@ -79,15 +108,22 @@ public:
   virtual double value();
   NAryRandomVariable(std::string filename);
   int loadSizes(std::string filename);
+  virtual EmpiricalRandomVariable *clone();
 
 protected:
   std::vector<double> flowSizes;
 };
 
+class AliasRandomVariable;
+
 class CDFRandomVariable : public EmpiricalRandomVariable {
 public:
   CDFRandomVariable(std::string filename);
   virtual double value();
+  virtual EmpiricalRandomVariable *clone();
+
+protected:
+  AliasRandomVariable *alias_;	// over the probability mass of each entry
 };
 
 class ConstantVariable : public EmpiricalRandomVariable {
@@ -95,17 +131,30 @@ public:
     double v;
     ConstantVariable(double value);
     double value();
+    virtual EmpiricalRandomVariable *clone();
 };
 
-class GaussianRandomVariable{
-  public:
-  double value();
+/*
+Walker/Vose alias table over a discrete set of weights.
+value() returns the sampled index in O(1) regardless of the number of weights.
+*/
+class AliasRandomVariable : public RandomVariable {
+public:
+  virtual double value();
+  AliasRandomVariable(const std::vector<double>& weights);
+  uint32_t sample();
+  uint32_t sample(double u);
+
+  std::vector<double> prob_;
+  std::vector<uint32_t> alias_;
+};
+
+class GaussianRandomVariable : public RandomVariable {
+public:
+  virtual double value();
   GaussianRandomVariable(double avg, double std);
   double avg;
   double std;
-
-  std::default_random_engine generator;
-  std::normal_distribution<double> *distribution;
 };
 
 #endif
@@ -1,3 +1,5 @@
+#include <map>
+
 #include "topology.h"
 
 extern DCExpParams params;
@@ -9,6 +11,48 @@ extern DCExpParams params;
    */
 Topology::Topology() {}
 
+static inline uint64_t oracle_fct_key(uint32_t path_class, uint32_t size) {
+    return ((uint64_t) path_class << 32) | size;
+}
+
+double Topology::get_oracle_fct(Flow *f) {
+    uint32_t path_class = get_path_class(f);
+    uint64_t key = oracle_fct_key(path_class, f->size);
+    auto it = oracle_fct_cache.find(key);
+    if (it != oracle_fct_cache.end()) {
+        return it->second;
+    }
+    double fct;
+    compute_oracle_fcts(path_class, &(f->size), &fct, 1);
+    oracle_fct_cache[key] = fct;
+    return fct;
+}
+
+/*
+ * Fills the oracle cache for a whole flow set at once. Sizes not yet in the
+ * cache are batched per path class so each class is computed in one pass.
+ */
+void Topology::fill_oracle_fct_cache(std::deque<Flow*>& flows) {
+    std::map<uint32_t, std::vector<uint32_t> > pending;
+    for (uint32_t i = 0; i < flows.size(); i++) {
+        uint32_t path_class = get_path_class(flows[i]);
+        uint64_t key = oracle_fct_key(path_class, flows[i]->size);
+        if (oracle_fct_cache.count(key) == 0) {
+            oracle_fct_cache[key] = 0;
+            pending[path_class].push_back(flows[i]->size);
+        }
+    }
+
+    for (auto it = pending.begin(); it != pending.end(); it++) {
+        std::vector<uint32_t>& sizes = it->second;
+        std::vector<double> fcts(sizes.size());
+        compute_oracle_fcts(it->first, sizes.data(), fcts.data(), sizes.size());
+        for (uint32_t i = 0; i < sizes.size(); i++) {
+            oracle_fct_cache[oracle_fct_key(it->first, sizes[i])] = fcts[i];
+        }
+    }
+}
+
 /*
  * PFabric topology with 144 hosts (16, 9, 4)
  */
@@ -115,11 +159,14 @@ Queue *PFabricTopology::get_next_hop(Packet *p, Queue *q) {
 }
 
 
-double PFabricTopology::get_oracle_fct(Flow *f) {
-    int num_hops = 4;
+uint32_t PFabricTopology::get_path_class(Flow *f) {
     if (f->src->id/16 == f->dst->id/16) {
-        num_hops = 2;
+        return 2;
     }
+    return 4;
+}
+
+void PFabricTopology::compute_oracle_fcts(uint32_t num_hops, const uint32_t* sizes, double* fcts, uint32_t n) {
     double propagation_delay;
     if (params.ddc != 0) { 
         if (num_hops == 2) {
@@ -130,53 +177,44 @@ double PFabricTopology::get_oracle_fct(Flow *f) {
         }
     }
     else {
-        propagation_delay = 2 * 1000000.0 * num_hops * f->src->queue->propagation_delay; //us
-    }
-   
-    double pkts = (double) f->size / params.mss;
-    uint32_t np = floor(pkts);
-    uint32_t leftover = (pkts - np) * params.mss;
-	double incl_overhead_bytes = (params.mss + f->hdr_size) * np + (leftover + f->hdr_size);
-
-    double bandwidth = f->src->queue->rate / 1000000.0; // For us
-    double transmission_delay;
-    if (params.cut_through) {
-        transmission_delay = 
-            (
-                np * (params.mss + params.hdr_size)
-                + 1 * params.hdr_size
-                + 2.0 * params.hdr_size // ACK has to travel two hops
-            ) * 8.0 / bandwidth;
-        if (num_hops == 4) {
-            //1 packet and 1 ack
-            transmission_delay += 2 * (2*params.hdr_size) * 8.0 / (4 * bandwidth);
+        propagation_delay = 2 * 1000000.0 * num_hops * hosts[0]->queue->propagation_delay; //us
+    }
+
+    double bandwidth = hosts[0]->queue->rate / 1000000.0; // For us
+    for (uint32_t i = 0; i < n; i++) {
+        double pkts = (double) sizes[i] / params.mss;
+        uint32_t np = floor(pkts);
+        uint32_t leftover = (pkts - np) * params.mss;
+        double incl_overhead_bytes = (params.mss + params.hdr_size) * np + (leftover + params.hdr_size);
+
+        double transmission_delay;
+        if (params.cut_through) {
+            transmission_delay = 
+                (
+                    np * (params.mss + params.hdr_size)
+                    + 1 * params.hdr_size
+                    + 2.0 * params.hdr_size // ACK has to travel two hops
+                ) * 8.0 / bandwidth;
+            if (num_hops == 4) {
+                //1 packet and 1 ack
+                transmission_delay += 2 * (2*params.hdr_size) * 8.0 / (4 * bandwidth);
+            }
+        }
+        else {
+            transmission_delay = (incl_overhead_bytes + 2.0 * params.hdr_size) * 8.0 / bandwidth;
+            if (num_hops == 4) {
+                // 1 packet and 1 ack
+                if (np == 0) {
+                    // less than mss sized flow. the 1 packet is leftover sized.
+                    transmission_delay += 2 * (leftover + 2*params.hdr_size) * 8.0 / (4 * bandwidth);
+                } else {
+                    // 1 packet is full sized
+                    transmission_delay += 2 * (params.mss + 2*params.hdr_size) * 8.0 / (4 * bandwidth);
+                }
+            }
         }
-        //std::cout << "pd: " << propagation_delay << " td: " << transmission_delay << std::endl;
+        fcts[i] = propagation_delay + transmission_delay; //us
     }
-    else {
-		transmission_delay = (incl_overhead_bytes + 2.0 * f->hdr_size) * 8.0 / bandwidth;
-		if (num_hops == 4) {
-			// 1 packet and 1 ack
-			if (np == 0) {
-				// less than mss sized flow. the 1 packet is leftover sized.
-				transmission_delay += 2 * (leftover + 2*params.hdr_size) * 8.0 / (4 * bandwidth);
-				
-			} else {
-				// 1 packet is full sized
-				transmission_delay += 2 * (params.mss + 2*params.hdr_size) * 8.0 / (4 * bandwidth);
-			}
-		}
-        //transmission_delay = 
-        //    (
-        //        (np + 1) * (params.mss + params.hdr_size) + (leftover + params.hdr_size)
-        //        + 2.0 * params.hdr_size // ACK has to travel two hops
-        //    ) * 8.0 / bandwidth;
-        //if (num_hops == 4) {
-        //    //1 packet and 1 ack
-        //    transmission_delay += 2 * (params.mss + 2*params.hdr_size) * 8.0 / (4 * bandwidth);  //TODO: 4 * bw is not right.
-        //}
-    }
-    return (propagation_delay + transmission_delay); //us
 }
 
 
@@ -224,25 +262,30 @@ Queue* BigSwitchTopology::get_next_hop(Packet *p, Queue *q) {
     assert(false);
 }
 
-double BigSwitchTopology::get_oracle_fct(Flow *f) {
-    double propagation_delay = 2 * 1000000.0 * 2 * f->src->queue->propagation_delay; //us
+uint32_t BigSwitchTopology::get_path_class(Flow *f) {
+    return 2;
+}
 
-    uint32_t np = ceil(f->size / params.mss); // TODO: Must be a multiple of 1460
-    double bandwidth = f->src->queue->rate / 1000000.0; // For us
-    double transmission_delay;
-    if (params.cut_through) {
-        transmission_delay = 
-            (
-                np * (params.mss + params.hdr_size)
-                + 1 * params.hdr_size
-                + 2.0 * params.hdr_size // ACK has to travel two hops
-            ) * 8.0 / bandwidth;
-    }
-    else {
-        transmission_delay = ((np + 1) * (params.mss + params.hdr_size) 
-                + 2.0 * params.hdr_size) // ACK has to travel two hops
-            * 8.0 / bandwidth;
+void BigSwitchTopology::compute_oracle_fcts(uint32_t num_hops, const uint32_t* sizes, double* fcts, uint32_t n) {
+    double propagation_delay = 2 * 1000000.0 * num_hops * hosts[0]->queue->propagation_delay; //us
+
+    double bandwidth = hosts[0]->queue->rate / 1000000.0; // For us
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t np = ceil(sizes[i] / params.mss); // TODO: Must be a multiple of 1460
+        double transmission_delay;
+        if (params.cut_through) {
+            transmission_delay = 
+                (
+                    np * (params.mss + params.hdr_size)
+                    + 1 * params.hdr_size
+                    + 2.0 * params.hdr_size // ACK has to travel two hops
+                ) * 8.0 / bandwidth;
+        }
+        else {
+            transmission_delay = ((np + 1) * (params.mss + params.hdr_size) 
+                    + 2.0 * params.hdr_size) // ACK has to travel two hops
+                * 8.0 / bandwidth;
+        }
+        fcts[i] = propagation_delay + transmission_delay; //us
     }
-    return (propagation_delay + transmission_delay); //us
 }
-
@@ -2,8 +2,10 @@
 #define TOPOLOGY_H
 
 #include <cstddef>
+#include <deque>
 #include <iostream>
 #include <math.h>
+#include <unordered_map>
 #include <vector>
 
 #include "node.h"
@@ -19,12 +21,19 @@ class Topology {
     public:
         Topology();
         virtual Queue *get_next_hop(Packet *p, Queue *q) = 0;
-        virtual double get_oracle_fct(Flow* f) = 0;
+
+        // The oracle FCT only depends on the path class (e.g. the number of
+        // hops) and the flow size, so results are memoized per (class, size).
+        double get_oracle_fct(Flow* f);
+        void fill_oracle_fct_cache(std::deque<Flow*>& flows);
+        virtual uint32_t get_path_class(Flow* f) = 0;
+        virtual void compute_oracle_fcts(uint32_t path_class, const uint32_t* sizes, double* fcts, uint32_t n) = 0;
 
         uint32_t num_hosts;
 
         std::vector<Host *> hosts;
         std::vector<Switch*> switches;
+        std::unordered_map<uint64_t, double> oracle_fct_cache;
 };
 
 class PFabricTopology : public Topology {
@@ -38,7 +47,8 @@ class PFabricTopology : public Topology {
                 );
 
         virtual Queue* get_next_hop(Packet *p, Queue *q);
-        virtual double get_oracle_fct(Flow* f);
+        virtual uint32_t get_path_class(Flow* f);
+        virtual void compute_oracle_fcts(uint32_t num_hops, const uint32_t* sizes, double* fcts, uint32_t n);
 
         uint32_t num_agg_switches;
         uint32_t num_core_switches;
@@ -52,7 +62,8 @@ class BigSwitchTopology : public Topology {
     public:
         BigSwitchTopology(uint32_t num_hosts, double bandwidth, uint32_t queue_type);
         virtual Queue *get_next_hop(Packet *p, Queue *q);
-        virtual double get_oracle_fct(Flow* f);
+        virtual uint32_t get_path_class(Flow* f);
+        virtual void compute_oracle_fcts(uint32_t num_hops, const uint32_t* sizes, double* fcts, uint32_t n);
 
         CoreSwitch* the_switch;
 };
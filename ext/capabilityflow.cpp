@@ -64,26 +64,16 @@ void CapabilityFlow::send_pending_data()
 
     if(debug_flow(this->id))
         std::cout << get_current_time() << " flow " << this->id << " send pkt " << this->total_pkt_sent << " " << p->size << "\n";
-
-    double td = src->queue->get_transmission_delay(p->size);
-    assert(((SchedulingHost*) src)->host_proc_event == NULL);
-    ((SchedulingHost*) src)->host_proc_event = new HostProcessingEvent(get_current_time() + td + INFINITESIMAL_TIME, (SchedulingHost*) src);
-    add_to_event_queue(((SchedulingHost*) src)->host_proc_event);
 }
 
 
 void CapabilityFlow::send_pending_data_low_prio()
 {
     assert(false);
-    Packet *p = this->send(this->next_seq_no, -1, -1, 9);
+    this->send(this->next_seq_no, -1, -1, 9);
     next_seq_no += mss;
     if(debug_flow(this->id))
         std::cout << get_current_time() << " flow " << this->id << " send pkt " << this->total_pkt_sent << "\n";
-
-    double td = src->queue->get_transmission_delay(p->size);
-    assert(((SchedulingHost*) src)->host_proc_event == NULL);
-    ((SchedulingHost*) src)->host_proc_event = new HostProcessingEvent(get_current_time() + td + INFINITESIMAL_TIME, (SchedulingHost*) src);
-    add_to_event_queue(((SchedulingHost*) src)->host_proc_event);
 }
 
 void CapabilityFlow::receive_rts(Packet* p) {
@@ -93,7 +83,7 @@ void CapabilityFlow::receive_rts(Packet* p) {
     this->rts_received = true;
     set_capability_count();
     ((CapabilityHost*)(this->dst))->hold_on = this->init_capa_size();
-    ((CapabilityHost*)(this->dst))->active_receiving_flows.push(this);
+    ((CapabilityHost*)(this->dst))->active_receiving_flows.push(this, this->redundancy_ctrl_timeout, get_current_time());
 
     if( ((CapabilityHost*)(this->dst))->capa_proc_evt &&
             ((CapabilityHost*)(this->dst))->capa_proc_evt->is_timeout_evt
@@ -125,9 +115,15 @@ void CapabilityFlow::receive(Packet *p)
             receive_rts(p);
         }
 
-        if(packets_received.count(p->capa_data_seq) == 0){
-            packets_received.insert(p->capa_data_seq);
+        CapabilityDataPkt *dp = (CapabilityDataPkt *) p;
+        if(packets_received.count(dp->capa_data_seq) == 0){
+            packets_received.insert(dp->capa_data_seq);
+            // the receiver orders its flows by remaining_pkts()
+            auto& receiving = ((CapabilityHost*)(this->dst))->active_receiving_flows.ready;
+            bool was_ready = receiving.erase(this) > 0;
             received_count++;
+            if(was_ready)
+                receiving.insert(this);
             while(received_until < size_in_pkt && packets_received.count(received_until) > 0)
             {
                 received_until++;
@@ -140,8 +136,8 @@ void CapabilityFlow::receive(Packet *p)
         else
             num_outstanding_packets = 0;
         total_queuing_time += p->total_queuing_delay;
-        if(p->capability_seq_num_in_data > largest_cap_seq_received)
-            largest_cap_seq_received = p->capability_seq_num_in_data;
+        if(dp->capability_seq_num_in_data > largest_cap_seq_received)
+            largest_cap_seq_received = dp->capability_seq_num_in_data;
 //        if(debug_flow(this->id))
 //            std::cout << get_current_time() << " flow " << this->id << " received pkt " << received_count << "\n";
         if (received_count >= goal) {
@@ -171,7 +167,11 @@ void CapabilityFlow::receive(Packet *p)
         c->seq_num = ((CapabilityPkt*)p)->cap_seq_num;
         c->data_seq_num = ((CapabilityPkt*)p)->data_seq_num;
         this->capabilities.push(c);
+        auto& sending = ((CapabilityHost*)(this->src))->active_sending_flows.ready;
+        bool was_ready = sending.erase(this) > 0;
         this->remaining_pkts_at_sender = ((CapabilityPkt*)p)->remaining_sz;
+        if(was_ready)
+            sending.insert(this);
 
         if(((CapabilityHost*)(this->src))->host_proc_event == NULL)
         {
@@ -188,7 +188,11 @@ void CapabilityFlow::receive(Packet *p)
     {
         if(CAPABILITY_NOTIFY_BLOCKING){
             StatusPkt* s = (StatusPkt*) p;
+            auto& receiving = ((CapabilityHost*)(this->dst))->active_receiving_flows.ready;
+            bool was_ready = receiving.erase(this) > 0;
             this->notified_num_flow_at_sender = s->num_flows_at_sender;
+            if(was_ready)
+                receiving.insert(this);
         }
 
     }
@@ -197,30 +201,16 @@ void CapabilityFlow::receive(Packet *p)
 
 bool CapabilityFlow::has_sibling_idle_source()
 {
-    bool has_idle = false;
     CapabilityHost* dst = (CapabilityHost*)this->dst;
-    std::queue<CapabilityFlow*> flows_tried;
-    while(!dst->active_receiving_flows.empty())
+    dst->active_receiving_flows.release(get_current_time());
+    auto& ready = dst->active_receiving_flows.ready;
+    for(auto it = ready.begin(); it != ready.end(); it++)
     {
-        CapabilityFlow* f = dst->active_receiving_flows.top();
-        dst->active_receiving_flows.pop();
-        flows_tried.push(f);
-        if(f != this && f->redundancy_ctrl_timeout <= get_current_time()
-                && ((CapabilityHost*)(f->src))->is_sender_idle())
-        {
-            has_idle = true;
-            break;
-        }
-
-    }
-
-    while(!flows_tried.empty())
-    {
-        dst->active_receiving_flows.push(flows_tried.front());
-        flows_tried.pop();
+        CapabilityFlow* f = *it;
+        if(f != this && ((CapabilityHost*)(f->src))->is_sender_idle())
+            return true;
     }
-
-    return has_idle;
+    return false;
 }
 
 Packet* CapabilityFlow::send(uint32_t seq, int capa_seq, int data_seq, int priority)
@@ -234,11 +224,9 @@ Packet* CapabilityFlow::send(uint32_t seq, int capa_seq, int data_seq, int prior
 		pkt_size = hdr_size + mss;
 	}
 
-    Packet *p = new Packet(get_current_time(), this, seq, priority, pkt_size, src, dst);
-    p->capability_seq_num_in_data = capa_seq;
-    p->capa_data_seq = data_seq;
+    Packet *p = new CapabilityDataPkt(get_current_time(), this, seq, priority, pkt_size, src, dst, capa_seq, data_seq);
     total_pkt_sent++;
-    add_to_event_queue(new PacketQueuingEvent(get_current_time(), p, src->queue));
+    ((SchedulingHost*) src)->pacer.transmit(p);
     return p;
 }
 
@@ -28,6 +28,10 @@ CapabilityProcessingEvent::~CapabilityProcessingEvent() {
     }
 }
 
+uint32_t CapabilityProcessingEvent::target_id() {
+    return host->id;
+}
+
 void CapabilityProcessingEvent::process_event() {
     this->host->capa_proc_evt = NULL;
     this->host->send_capability();
@@ -40,12 +44,16 @@ SenderNotifyEvent::SenderNotifyEvent(double time, CapabilityHost* h) : Event(SEN
 SenderNotifyEvent::~SenderNotifyEvent() {
 }
 
+uint32_t SenderNotifyEvent::target_id() {
+    return host->id;
+}
+
 void SenderNotifyEvent::process_event() {
     this->host->sender_notify_evt = NULL;
     this->host->notify_flow_status();
 }
 
-bool CapabilityFlowComparator::operator() (CapabilityFlow* a, CapabilityFlow* b){
+bool CapabilityFlowComparator::operator() (CapabilityFlow* a, CapabilityFlow* b) const {
     //return a->remaining_pkts_at_sender > b->remaining_pkts_at_sender;
     if(params.deadline && params.schedule_by_deadline) {
         return a->deadline > b->deadline;
@@ -62,7 +70,7 @@ bool CapabilityFlowComparator::operator() (CapabilityFlow* a, CapabilityFlow* b)
     }
 }
 
-bool CapabilityFlowComparatorAtReceiver::operator() (CapabilityFlow* a, CapabilityFlow* b){
+bool CapabilityFlowComparatorAtReceiver::operator() (CapabilityFlow* a, CapabilityFlow* b) const {
     //return a->size_in_pkt > b->size_in_pkt;
     if(params.deadline && params.schedule_by_deadline) {
         return a->deadline > b->deadline;
@@ -89,9 +97,9 @@ CapabilityHost::CapabilityHost(uint32_t id, double rate, uint32_t queue_type) :
     this->capa_proc_evt = NULL;
     this->hold_on = 0;
     this->total_capa_schd_evt_count = 0;
-    this->could_better_schd_count = 0;
     this->sender_notify_evt = NULL;
     this->host_type = CAPABILITY_HOST;
+    this->rng.set_stream(id, RNG_CAPABILITY);
 }
 
 void CapabilityHost::start_capability_flow(CapabilityFlow* f) {
@@ -103,7 +111,7 @@ void CapabilityHost::start_capability_flow(CapabilityFlow* f) {
             << " curr q size " << this->queue->bytes_in_queue 
             << " num flows " << this->active_receiving_flows.size() <<"\n";
 
-    this->active_sending_flows.push(f);
+    this->active_sending_flows.push(f, 0, get_current_time());
     f->send_rts_pkt();
     if(f->has_capability() && ((CapabilityHost*)(f->src))->host_proc_event == NULL) {
         ((CapabilityHost*)(f->src))->schedule_host_proc_evt();
@@ -117,8 +125,9 @@ void CapabilityHost::schedule_host_proc_evt(){
 
     double qpe_time = 0;
     double td_time = 0;
+    this->queue->settle();
     if(this->queue->busy){
-        qpe_time = this->queue->queue_proc_event->time;
+        qpe_time = this->queue->transmission_end();
     }
     else{
         qpe_time = get_current_time();
@@ -131,6 +140,13 @@ void CapabilityHost::schedule_host_proc_evt(){
     add_to_event_queue(this->host_proc_event);
 }
 
+void CapabilityHost::schedule_train_end()
+{
+    assert(this->host_proc_event == NULL);
+    this->host_proc_event = new HostProcessingEvent(this->pacer.train_end + INFINITESIMAL_TIME, this);
+    add_to_event_queue(this->host_proc_event);
+}
+
 void CapabilityHost::schedule_capa_proc_evt(double time, bool is_timeout)
 {
     assert(this->capa_proc_evt == NULL);
@@ -151,6 +167,7 @@ void CapabilityHost::send(){
     assert(this->host_proc_event == NULL);
 
 
+    this->queue->settle();
     if(this->queue->busy)
     {
         schedule_host_proc_evt();
@@ -159,24 +176,28 @@ void CapabilityHost::send(){
     {
         bool pkt_sent = false;
         std::queue<CapabilityFlow*> flows_tried;
-        while(!this->active_sending_flows.empty()){
-            if(this->active_sending_flows.top()->finished){
-                this->active_sending_flows.pop();
+        auto it = this->active_sending_flows.ready.begin();
+        while(it != this->active_sending_flows.ready.end()){
+            CapabilityFlow* top_flow = *it;
+            if(top_flow->finished){
+                it = this->active_sending_flows.ready.erase(it);
                 continue;
             }
 
-            CapabilityFlow* top_flow = this->active_sending_flows.top();
-
-
             if(top_flow->has_capability())
             {
-                top_flow->send_pending_data();
+                // a train spends capabilities already in hand
+                this->pacer.start_train();
+                uint32_t train = this->pacer.train_length(top_flow->capabilities.size());
+                for(uint32_t i = 0; i < train && top_flow->has_capability(); i++)
+                    top_flow->send_pending_data();
+                this->schedule_train_end();
                 pkt_sent = true;
                 break;
             }
             else{
-                this->active_sending_flows.pop();
                 flows_tried.push(top_flow);
+                it++;
             }
 
         }
@@ -190,75 +211,52 @@ void CapabilityHost::send(){
             }
 
             if(candidate.size()){
-                int f_index = rand()%candidate.size();
+                int f_index = rng.below(candidate.size());
+                this->pacer.start_train();
                 candidate[f_index]->send_pending_data_low_prio();
+                this->schedule_train_end();
             }
 
         }
 
-        while(!flows_tried.empty())
-        {
-            CapabilityFlow* f = flows_tried.front();
-            flows_tried.pop();
-            this->active_sending_flows.push(f);
-        }
-
     }
 
 }
 
 void CapabilityHost::notify_flow_status()
 {
-    std::queue<CapabilityFlow*> flows_tried;
     int num_large_flow = 0;
 
-    while(!this->active_sending_flows.empty())
+    auto it = this->active_sending_flows.ready.begin();
+    while(it != this->active_sending_flows.ready.end())
     {
-        CapabilityFlow* f = this->active_sending_flows.top();
-        this->active_sending_flows.pop();
-        if(!f->finished){
-            flows_tried.push(f);
-            if(f->size_in_pkt > params.capability_initial)
-                num_large_flow++;
+        CapabilityFlow* f = *it;
+        if(f->finished){
+            it = this->active_sending_flows.ready.erase(it);
+            continue;
         }
+        if(f->size_in_pkt > params.capability_initial)
+            num_large_flow++;
+        it++;
     }
 
-    while(!flows_tried.empty()){
-        this->active_sending_flows.push(flows_tried.front());
-        if(flows_tried.front()->size_in_pkt > params.capability_initial)
-            flows_tried.front()->send_notify_pkt(num_large_flow>2?2:1);
-        flows_tried.pop();
+    for(it = this->active_sending_flows.ready.begin(); it != this->active_sending_flows.ready.end(); it++){
+        if((*it)->size_in_pkt > params.capability_initial)
+            (*it)->send_notify_pkt(num_large_flow>2?2:1);
     }
 
     if(!this->active_sending_flows.empty())
         this->schedule_sender_notify_evt();
 }
 
-bool CapabilityHost::check_better_schedule(CapabilityFlow* f)
-{
-    return ((CapabilityHost*)f->src)->active_sending_flows.top() == f;
-}
-
 bool CapabilityHost::is_sender_idle(){
-    bool idle = true;
-    std::queue<CapabilityFlow*> flows_tried;
-    while(!this->active_sending_flows.empty())
+    auto& ready = this->active_sending_flows.ready;
+    for(auto it = ready.begin(); it != ready.end(); it++)
     {
-        CapabilityFlow* f = this->active_sending_flows.top();
-        this->active_sending_flows.pop();
-        flows_tried.push(f);
-        if(f->has_capability()){
-            idle = false;
-            break;
-        }
-    }
-    while(!flows_tried.empty())
-    {
-        this->active_sending_flows.push(flows_tried.front());
-        flows_tried.pop();
+        if((*it)->has_capability())
+            return false;
     }
-
-    return idle;
+    return true;
 }
 
 void CapabilityHost::send_capability(){
@@ -267,9 +265,7 @@ void CapabilityHost::send_capability(){
     assert(capa_proc_evt == NULL);
 
     bool capability_sent = false;
-    bool could_schd_better = false;
     this->total_capa_schd_evt_count++;
-    std::queue<CapabilityFlow*> flows_tried;
     double closet_timeout = 999999;
 
     if(CAPABILITY_HOLD && this->hold_on > 0){
@@ -277,77 +273,66 @@ void CapabilityHost::send_capability(){
         capability_sent = true;
     }
 
-    while(!this->active_receiving_flows.empty() && !capability_sent)
+    // flows still within their redundancy timeout are not looked at
+    this->active_receiving_flows.release(get_current_time());
+    auto& ready = this->active_receiving_flows.ready;
+    auto it = ready.begin();
+    while(it != ready.end() && !capability_sent)
     {
-        CapabilityFlow* f = this->active_receiving_flows.top();
-        this->active_receiving_flows.pop();
-        //if(debug_flow(f->id))
-        //    std::cout << get_current_time() << " pop out flow " << f->id << "\n";
-
+        CapabilityFlow* f = *it;
 
         if(f->finished_at_receiver)
         {
+            it = ready.erase(it);
             continue;
         }
-        flows_tried.push(f);
 
-        //not yet timed out, shouldn't send
-        if(f->redundancy_ctrl_timeout > get_current_time()){
-            if(check_better_schedule(f))
-                could_schd_better = true;
-            if(f->redundancy_ctrl_timeout < closet_timeout)
-            {
-                closet_timeout = f->redundancy_ctrl_timeout;
-            }
-        }
-        //ok to send
-        else
+        //just timeout, reset timeout state
+        if(f->redundancy_ctrl_timeout > 0)
         {
-            //just timeout, reset timeout state
-            if(f->redundancy_ctrl_timeout > 0)
-            {
-                f->redundancy_ctrl_timeout = -1;
-                f->capability_goal += f->remaining_pkts();
-            }
+            f->redundancy_ctrl_timeout = -1;
+            f->capability_goal += f->remaining_pkts();
+        }
 
-            if(f->capability_gap() > params.capability_window)
-            {
-                if(get_current_time() >= f->latest_cap_sent_time + params.capability_window_timeout * params.get_full_pkt_tran_delay())
-                    f->relax_capability_gap();
-                else{
-                    if(f->latest_cap_sent_time + params.capability_window_timeout * params.get_full_pkt_tran_delay() < closet_timeout)
-                    {
-                        closet_timeout = f->latest_cap_sent_time + params.capability_window_timeout* params.get_full_pkt_tran_delay();
-                    }
+        if(f->capability_gap() > params.capability_window)
+        {
+            if(get_current_time() >= f->latest_cap_sent_time + params.capability_window_timeout * params.get_full_pkt_tran_delay())
+                f->relax_capability_gap();
+            else{
+                if(f->latest_cap_sent_time + params.capability_window_timeout * params.get_full_pkt_tran_delay() < closet_timeout)
+                {
+                    closet_timeout = f->latest_cap_sent_time + params.capability_window_timeout* params.get_full_pkt_tran_delay();
                 }
-
             }
 
+        }
 
-            if(f->capability_gap() <= params.capability_window)
-            {
-                f->send_capability_pkt();
-                capability_sent = true;
 
-                if(f->capability_count == f->capability_goal){
-                    f->redundancy_ctrl_timeout = get_current_time() + params.capability_resend_timeout * params.get_full_pkt_tran_delay();
-                }
+        if(f->capability_gap() <= params.capability_window)
+        {
+            f->send_capability_pkt();
+            capability_sent = true;
 
-                break;
+            if(f->capability_count == f->capability_goal){
+                f->redundancy_ctrl_timeout = get_current_time() + params.capability_resend_timeout * params.get_full_pkt_tran_delay();
+                this->active_receiving_flows.block(it, f->redundancy_ctrl_timeout);
             }
 
-
+            break;
         }
+        it++;
     }
 
-    while(!flows_tried.empty()){
-        CapabilityFlow* tf = flows_tried.front();
-        flows_tried.pop();
-        this->active_receiving_flows.push(tf);
+    if(!capability_sent)
+    {
+        auto& blocked = this->active_receiving_flows.blocked;
+        while(!blocked.empty() && blocked.top().flow->finished_at_receiver)
+            blocked.pop();
+        if(!blocked.empty() && blocked.top().time < closet_timeout)
+            closet_timeout = blocked.top().time;
     }
 
 
-
     if(capability_sent)// pkt sent
     {
         this->schedule_capa_proc_evt(params.get_full_pkt_tran_delay(1500/* + 40*/), false);
@@ -360,8 +345,4 @@ void CapabilityHost::send_capability(){
     else{
         //do nothing, no unfinished flow
     }
-
-    if(could_schd_better)
-        this->could_better_schd_count++;
 }
-
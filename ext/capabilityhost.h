@@ -7,9 +7,10 @@
 #include "../coresim/node.h"
 #include "../coresim/packet.h"
 #include "../coresim/event.h"
+#include "../coresim/random_stream.h"
 
 #include "schedulinghost.h"
-#include "custompriorityqueue.h"
+#include "eligibilityqueue.h"
 
 class CapabilityFlow;
 class CapabilityProcessingEvent;
@@ -17,36 +18,36 @@ class SenderNotifyEvent;
 
 class CapabilityFlowComparator {
     public:
-        bool operator() (CapabilityFlow* a, CapabilityFlow* b);
+        bool operator() (CapabilityFlow* a, CapabilityFlow* b) const;
 };
 
 class CapabilityFlowComparatorAtReceiver {
     public:
-        bool operator() (CapabilityFlow* a, CapabilityFlow* b);
+        bool operator() (CapabilityFlow* a, CapabilityFlow* b) const;
 };
 
 class CapabilityHost : public SchedulingHost {
     public:
         CapabilityHost(uint32_t id, double rate, uint32_t queue_type);
         void schedule_host_proc_evt();
+        void schedule_train_end();
         void start_capability_flow(CapabilityFlow* f);
         void send();
-        //std::priority_queue<CapabilityFlow*, std::vector<CapabilityFlow*>, CapabilityFlowComparator> active_sending_flows;
-        CustomPriorityQueue<CapabilityFlow*, std::vector<CapabilityFlow*>, CapabilityFlowComparator> active_sending_flows;
+        // senders are never blocked, they wait for capabilities instead
+        EligibilityQueue<CapabilityFlow, CapabilityFlowComparator> active_sending_flows;
 
         void send_capability();
         void schedule_capa_proc_evt(double time, bool is_timeout);
         void schedule_sender_notify_evt();
-        bool check_better_schedule(CapabilityFlow* f);
         bool is_sender_idle();
         void notify_flow_status();
-        //std::priority_queue<CapabilityFlow*, std::vector<CapabilityFlow*>, CapabilityFlowComparatorAtReceiver> active_receiving_flows;
-        CustomPriorityQueue<CapabilityFlow*, std::vector<CapabilityFlow*>, CapabilityFlowComparatorAtReceiver> active_receiving_flows;
+        // blocked until redundancy_ctrl_timeout
+        EligibilityQueue<CapabilityFlow, CapabilityFlowComparatorAtReceiver> active_receiving_flows;
         CapabilityProcessingEvent *capa_proc_evt;
         SenderNotifyEvent* sender_notify_evt;
         int hold_on;
         int total_capa_schd_evt_count;
-        int could_better_schd_count;
+        RandomStream rng;
 };
 
 #define CAPABILITY_PROCESSING 11
@@ -55,6 +56,7 @@ class CapabilityProcessingEvent : public Event {
         CapabilityProcessingEvent(double time, CapabilityHost *host, bool is_timeout);
         ~CapabilityProcessingEvent();
         void process_event();
+        uint32_t target_id();
         CapabilityHost *host;
         bool is_timeout_evt;
 };
@@ -65,6 +67,7 @@ class SenderNotifyEvent : public Event {
         SenderNotifyEvent(double time, CapabilityHost *host);
         ~SenderNotifyEvent();
         void process_event();
+        uint32_t target_id();
         CapabilityHost *host;
 };
 
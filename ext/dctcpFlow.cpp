@@ -19,8 +19,7 @@ DctcpFlow::DctcpFlow(
     Host *s, 
     Host *d
     ) : Flow(id, start_time, size, s, d) {
-    //ce_state = false;
-    //delayed_ack_counter = 0;
+    ce_state = false;
     dctcp_g = 0.0625;
     dctcp_alpha = 0;
     ecn_history = new std::deque<bool>(max_cwnd);
@@ -48,112 +47,22 @@ void DctcpFlow::receive(Packet* p) {
 
 //Receiver Side
 
-//Delayed Ack Implementation
-/*
-void DctcpFlow::mark_receipt(Packet* p) {
-    received_count++;
-    total_queuing_time += p->total_queuing_delay;
-
-    if (received.count(p->seq_no) == 0) {
-        received[p->seq_no] = true;
-        if(num_outstanding_packets >= ((p->size - hdr_size) / (mss)))
-            num_outstanding_packets -= ((p->size - hdr_size) / (mss));
-        else
-            num_outstanding_packets = 0;
-        received_bytes += (p->size - hdr_size);
-    } else {
-        duplicated_packets_received += 1;
-    }
-    if (p->seq_no > max_seq_no_recv) {
-        max_seq_no_recv = p->seq_no;
-    }
-}
-
-void DctcpFlow::determine_ack(DctcpPacket* p) {
-    // Determing which ack to send
-    uint32_t s = recv_till;
-    bool in_sequence = true;
-    std::vector<uint32_t> sack_list;
-    while (s <= max_seq_no_recv) {
-        if (received.count(s) > 0) {
-            if (in_sequence) {
-                recv_till += mss;
-            } else {
-                sack_list.push_back(s);
-            }
-        } else {
-            in_sequence = false;
-        }
-        s += mss;
-    }
-
-    //send_ack(recv_till, sack_list); // Cumulative Ack
-    Packet* a = new DctcpAck(this, recv_till, sack_list, hdr_size, dst, src, p->ecn, delayed_ack_counter);
-    add_to_event_queue(new PacketQueuingEvent(get_current_time(), a, dst->queue));
-}
-
 void DctcpFlow::receive_data_pkt(Packet* p) {
-    mark_receipt(p);
-
-    DctcpPacket *dcp = (DctcpPacket*) p;
-    if (ce_state) {
-        if (dcp->ecn) {
-            if (delayed_ack_counter == params.dctcp_delayed_ack_freq) {
-                determine_ack(dcp);
-                delayed_ack_counter = 0;
-            }
-            else {
-                delayed_ack_counter++;
-            }
-        }
-        else {
-            determine_ack(dcp);
-            delayed_ack_counter = 0;
-            ce_state = false;
-        }
-    }
-    else {
-        if (dcp->ecn) {
-            determine_ack(dcp);
-            delayed_ack_counter = 0;
-            ce_state = true;
-        }
-        else {
-            if (delayed_ack_counter == params.dctcp_delayed_ack_freq) {
-                determine_ack(dcp);
-                delayed_ack_counter = 0;
-            }
-            else {
-                delayed_ack_counter++;
-            }
-        }
+    bool ecn = ((DctcpPacket*) p)->ecn;
+    if (ecn != ce_state && delayed_acks > 0) {
+        send_delayed_ack();
     }
-}
-*/
+    ce_state = ecn;
 
-void DctcpFlow::receive_data_pkt(Packet* p) {
-    received_count++;
-    total_queuing_time += p->total_queuing_delay;
+    bool in_order = p->seq_no == recv_till;
+    mark_receipt(p);
 
-    if (received.count(p->seq_no) == 0) {
-        received[p->seq_no] = true;
-        if(num_outstanding_packets >= ((p->size - hdr_size) / (mss)))
-            num_outstanding_packets -= ((p->size - hdr_size) / (mss));
-        else
-            num_outstanding_packets = 0;
-        received_bytes += (p->size - hdr_size);
-    } else {
-        duplicated_packets_received += 1;
-    }
-    if (p->seq_no > max_seq_no_recv) {
-        max_seq_no_recv = p->seq_no;
-    }
     // Determing which ack to send
     uint32_t s = recv_till;
     bool in_sequence = true;
     std::vector<uint32_t> sack_list;
     while (s <= max_seq_no_recv) {
-        if (received.count(s) > 0) {
+        if (has_received(s)) {
             if (in_sequence) {
                 recv_till += mss;
             } else {
@@ -165,7 +74,11 @@ void DctcpFlow::receive_data_pkt(Packet* p) {
         s += mss;
     }
 
-    Packet *a = new DctcpAck(this, recv_till, sack_list, hdr_size, dst, src, ((DctcpPacket*) p)->ecn); //Acks are dst->src
+    ack_data(in_order, sack_list);
+}
+
+void DctcpFlow::send_ack(uint32_t seq, std::vector<uint32_t> sack_list) {
+    Packet *a = new DctcpAck(this, seq, sack_list, hdr_size, dst, src, ce_state, delayed_acks); //Acks are dst->src
     add_to_event_queue(new PacketQueuingEvent(get_current_time(), a, dst->queue));
 }
 
@@ -193,10 +106,11 @@ void DctcpFlow::receive_ack(Ack* a) {
         // Update the last unacked seq
         last_unacked_seq = ack;
         
-        // Update ecn_history
-        //for (uint32_t i = 0; i < dca->delayed_num; i++) // only needed for delayed ack
+        // Update ecn_history, once for each packet the ack covers
         assert(dca->ecn == 1 || dca->ecn == 0);
-        ecn_history->push_front(dca->ecn);
+        for (uint32_t i = 0; i < dca->delayed_num; i++) {
+            ecn_history->push_front(dca->ecn);
+        }
         while (ecn_history->size() > max_cwnd) 
             ecn_history->pop_back();
 
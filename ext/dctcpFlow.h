@@ -13,21 +13,17 @@ class DctcpFlow : public Flow {
 
         // Receiver Side
         virtual void receive_data_pkt(Packet* p);
-        //void mark_receipt(Packet* p);
-        //void determine_ack(DctcpPacket* p);
-       
-        // After looking at DCTCP NS2 code, Delayed ACK is not used.
-        //
+        virtual void send_ack(uint32_t seq, std::vector<uint32_t> sack_list);
+
         // ECN-Echo + Delayed ACK state machine
         //
         // while no ECN set, send 1 ACK per m packets with ECN = 0
         // if ECN set in received packet, immediately send ACK with ECN = 0
         // while ECN = 1, send 1 ACK per m packets with ECN = 1
         // if ECN not set in received packet, immediately send ACK with ECN = 1
-        // delayed ACK m number typically = 2. params.dctcp_delayed_ack_freq
+        // m is params.delayed_ack_freq, 1 by default as in the DCTCP NS2 code
 
-        //bool ce_state;
-        //uint32_t delayed_ack_counter;
+        bool ce_state;
 
         // Sender Side
         virtual void receive(Packet* p);
@@ -5,6 +5,7 @@
 #include "dctcpPacket.h"
 
 #include "../run/params.h"
+#include "../run/packet_trace.h"
 
 extern double get_current_time();
 extern void add_to_event_queue(Event *ev);
@@ -25,9 +26,15 @@ void DctcpQueue::enque(Packet *packet) {
     if (bytes_in_queue + packet->size <= limit_bytes) {
         packets.push_back(packet);
         bytes_in_queue += packet->size;
+        if (packet_trace != NULL) {
+            packet_trace->add(this, packet, PACKET_TRACE_ENQUEUE);
+        }
 
         if (packets.size() >= params.dctcp_mark_thresh) {
             ((DctcpPacket*) packet)->ecn = true;
+            if (packet_trace != NULL) {
+                packet_trace->add(this, packet, PACKET_TRACE_ECN);
+            }
         }
     } 
     else {
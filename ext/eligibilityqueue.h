@@ -0,0 +1,103 @@
+#ifndef ELIGIBILITY_QUEUE_H
+#define ELIGIBILITY_QUEUE_H
+
+#include <set>
+#include <queue>
+#include <vector>
+#include <stdint.h>
+
+// priority order for a set: Compare is a priority_queue comparator (true if
+// a has lower priority than b), ties go to the lower flow id
+template<typename T, typename Compare>
+class EligibilityOrder {
+    public:
+        bool operator() (T* a, T* b) const {
+            if (comp(b, a)) {
+                return true;
+            }
+            if (comp(a, b)) {
+                return false;
+            }
+            return a->id < b->id;
+        }
+        Compare comp;
+};
+
+template<typename T>
+struct EligibilityEntry {
+    double time;
+    T* flow;
+};
+
+template<typename T>
+class EligibilityTimeOrder {
+    public:
+        bool operator() (const EligibilityEntry<T>& a, const EligibilityEntry<T>& b) const {
+            return a.time > b.time;
+        }
+};
+
+/*
+ * The flows a host schedules, split by whether they can be picked now.
+ * Ready flows are kept in priority order, so a scheduling decision walks
+ * them from the front and stops at the first one it can use. Blocked flows
+ * wait in a heap ordered by the time they become eligible and are moved to
+ * the ready set by release().
+ *
+ * The ready set is ordered by the flows' current priority: whatever Compare
+ * reads may only change while the flow is out of the set, e.g.
+ *
+ *     bool was_ready = q.ready.erase(f) > 0;
+ *     ... change f ...
+ *     if (was_ready) q.ready.insert(f);
+ *
+ * Blocked flows may change freely. Flows that finish while blocked are left
+ * in the heap; callers drop them when they come up.
+ */
+template<typename T, typename Compare>
+class EligibilityQueue {
+    public:
+        typedef std::set<T*, EligibilityOrder<T, Compare> > ReadySet;
+
+        ReadySet ready;
+        std::priority_queue<EligibilityEntry<T>, std::vector<EligibilityEntry<T> >, EligibilityTimeOrder<T> > blocked;
+
+        bool empty() const {
+            return ready.empty() && blocked.empty();
+        }
+
+        uint32_t size() const {
+            return ready.size() + blocked.size();
+        }
+
+        // f may be picked from eligible_at on
+        void push(T* f, double eligible_at, double now) {
+            if (eligible_at > now) {
+                EligibilityEntry<T> e;
+                e.time = eligible_at;
+                e.flow = f;
+                blocked.push(e);
+            }
+            else {
+                ready.insert(f);
+            }
+        }
+
+        // takes a ready flow out until eligible_at; returns the next ready flow
+        typename ReadySet::iterator block(typename ReadySet::iterator it, double eligible_at) {
+            EligibilityEntry<T> e;
+            e.time = eligible_at;
+            e.flow = *it;
+            blocked.push(e);
+            return ready.erase(it);
+        }
+
+        void release(double now) {
+            while (!blocked.empty() && blocked.top().time <= now) {
+                ready.insert(blocked.top().flow);
+                blocked.pop();
+            }
+        }
+};
+
+#endif
@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <queue>
+#include "assert.h"
+
+#include "../coresim/node.h"
+#include "../coresim/event.h"
+
+#include "fastpassallocator.h"
+#include "fastpassflow.h"
+
+extern DCExpParams params;
+
+bool FastpassFlowComparator::operator() (FastpassFlow* a, FastpassFlow* b) const {
+    if (a->arbiter_queued_remaining != b->arbiter_queued_remaining) {
+        return a->arbiter_queued_remaining < b->arbiter_queued_remaining;
+    }
+    return a->id < b->id;
+}
+
+void HostBitset::resize(uint32_t num_hosts) {
+    words.assign((num_hosts + 63) / 64, 0);
+}
+
+void HostBitset::clear() {
+    std::fill(words.begin(), words.end(), 0);
+}
+
+
+FastpassAllocator::FastpassAllocator(uint32_t num_hosts) {
+    this->num_hosts = num_hosts;
+    this->requests.resize(num_hosts);
+    this->num_requests = 0;
+    this->dst_busy.resize(num_hosts);
+    this->pipeline = NULL;
+    if (params.fastpass_pipeline_threads > 0) {
+        this->pipeline = new FastpassPipeline(num_hosts, params.fastpass_pipeline_threads);
+    }
+}
+
+FastpassAllocator::~FastpassAllocator() {
+    delete pipeline;
+}
+
+// requests are keyed by arbiter_queued_remaining, so it only changes while out of the set
+void FastpassAllocator::remove_request(FastpassFlow* f) {
+    if (f->arbiter_queued_remaining < 0) {
+        return;
+    }
+    uint32_t src = f->src->id;
+    requests[src].erase(f);
+    if (requests[src].empty()) {
+        active_srcs.erase(src);
+    }
+    f->arbiter_queued_remaining = -1;
+    num_requests--;
+}
+
+void FastpassAllocator::add_request(FastpassFlow* f) {
+    if (f->arbiter_finished || f->arbiter_remaining_num_pkts <= 0) {
+        return;
+    }
+    uint32_t src = f->src->id;
+    f->arbiter_queued_remaining = f->arbiter_remaining_num_pkts;
+    requests[src].insert(f);
+    active_srcs.insert(src);
+    num_requests++;
+}
+
+void FastpassAllocator::update_request(FastpassFlow* f) {
+    remove_request(f);
+    add_request(f);
+}
+
+bool FastpassAllocator::has_requests() {
+    return num_requests > 0;
+}
+
+struct FastpassRequestHead {
+    FastpassFlow* flow;
+    uint32_t src;
+    std::set<FastpassFlow*, FastpassFlowComparator>::iterator next;
+};
+
+struct FastpassRequestHeadComparator {
+    bool operator() (const FastpassRequestHead& a, const FastpassRequestHead& b) {
+        return FastpassFlowComparator()(b.flow, a.flow);
+    }
+};
+
+/*
+ * Greedy in request order: merge the request sets of all sources and give a
+ * flow the slot if its destination is still free. A source leaves the merge
+ * as soon as it gets the slot.
+ */
+void FastpassAllocator::allocate_timeslot(uint32_t slot, std::vector<FastpassFlow*>& slots) {
+    std::priority_queue<FastpassRequestHead, std::vector<FastpassRequestHead>, FastpassRequestHeadComparator> heads;
+    for (auto it = active_srcs.begin(); it != active_srcs.end(); it++) {
+        FastpassRequestHead h;
+        h.src = *it;
+        h.next = requests[*it].begin();
+        h.flow = *h.next;
+        h.next++;
+        heads.push(h);
+    }
+
+    dst_busy.clear();
+    allocated.clear();
+    while (!heads.empty()) {
+        FastpassRequestHead h = heads.top();
+        heads.pop();
+        uint32_t dst = h.flow->dst->id;
+        if (!dst_busy.test(dst)) {
+            dst_busy.set(dst);
+            slots[h.src * FASTPASS_EPOCH_PKTS + slot] = h.flow;
+            allocated.push_back(h.flow);
+            continue;
+        }
+        if (h.next != requests[h.src].end()) {
+            h.flow = *h.next;
+            h.next++;
+            heads.push(h);
+        }
+    }
+
+    for (uint32_t i = 0; i < allocated.size(); i++) {
+        FastpassFlow* f = allocated[i];
+        remove_request(f);
+        f->arbiter_remaining_num_pkts--;
+        add_request(f);
+    }
+}
+
+void FastpassAllocator::allocate_epoch(std::vector<FastpassFlow*>& slots) {
+    if (pipeline == NULL) {
+        for (uint32_t i = 0; i < FASTPASS_EPOCH_PKTS && has_requests(); i++) {
+            allocate_timeslot(i, slots);
+        }
+        return;
+    }
+
+    std::vector<FastpassFlow*> flows;
+    for (auto it = active_srcs.begin(); it != active_srcs.end(); it++) {
+        flows.insert(flows.end(), requests[*it].begin(), requests[*it].end());
+    }
+    std::sort(flows.begin(), flows.end(), FastpassFlowComparator());
+    std::vector<int> demand(flows.size());
+    for (uint32_t i = 0; i < flows.size(); i++) {
+        demand[i] = flows[i]->arbiter_queued_remaining;
+    }
+
+    pipeline->allocate_epoch(flows, demand, slots);
+
+    for (uint32_t i = 0; i < flows.size(); i++) {
+        FastpassFlow* f = flows[i];
+        if (demand[i] == f->arbiter_queued_remaining) {
+            continue;
+        }
+        remove_request(f);
+        f->arbiter_remaining_num_pkts = demand[i];
+        add_request(f);
+    }
+}
+
+
+FastpassPipeline::FastpassPipeline(uint32_t num_hosts, uint32_t num_threads) {
+    uint32_t num_stages = std::min(num_threads, (uint32_t) FASTPASS_EPOCH_PKTS);
+    this->epoch = 0;
+    this->shutdown = false;
+    this->epoch_done = 0;
+    for (uint32_t s = 0; s < num_stages; s++) {
+        FastpassPipelineStage* stage = new FastpassPipelineStage();
+        stage->first_slot = s * FASTPASS_EPOCH_PKTS / num_stages;
+        stage->last_slot = (s + 1) * FASTPASS_EPOCH_PKTS / num_stages;
+        for (uint32_t k = 0; k < FASTPASS_EPOCH_PKTS; k++) {
+            stage->src_busy[k].resize(num_hosts);
+            stage->dst_busy[k].resize(num_hosts);
+        }
+        stages.push_back(stage);
+    }
+    for (uint32_t s = 0; s < num_stages; s++) {
+        stages[s]->worker = std::thread([this, s] { run_stage(s); });
+    }
+}
+
+FastpassPipeline::~FastpassPipeline() {
+    {
+        std::lock_guard<std::mutex> l(lock);
+        shutdown = true;
+    }
+    epoch_start.notify_all();
+    for (uint32_t s = 0; s < stages.size(); s++) {
+        stages[s]->worker.join();
+        delete stages[s];
+    }
+}
+
+// feeds the flows through the stages and waits for the last one to finish
+void FastpassPipeline::allocate_epoch(std::vector<FastpassFlow*>& flows, std::vector<int>& demand,
+        std::vector<FastpassFlow*>& slots) {
+    uint64_t this_epoch;
+    {
+        std::lock_guard<std::mutex> l(lock);
+        this->flows = &flows;
+        this->demand = &demand;
+        this->slots = &slots;
+        this_epoch = ++epoch;
+    }
+    epoch_start.notify_all();
+
+    for (uint32_t i = 0; i <= flows.size(); i++) {
+        uint32_t item = i < flows.size() ? i : FASTPASS_PIPELINE_END;
+        while (!stages[0]->input.push(item)) {
+            std::this_thread::yield();
+        }
+    }
+    while (epoch_done.load(std::memory_order_acquire) != this_epoch) {
+        std::this_thread::yield();
+    }
+}
+
+void FastpassPipeline::run_stage(uint32_t s) {
+    FastpassPipelineStage* stage = stages[s];
+    FastpassPipelineStage* next = s + 1 < stages.size() ? stages[s + 1] : NULL;
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> l(lock);
+            epoch_start.wait(l, [this, seen] { return shutdown || epoch > seen; });
+            if (shutdown) {
+                return;
+            }
+            seen = epoch;
+        }
+        for (uint32_t k = stage->first_slot; k < stage->last_slot; k++) {
+            stage->src_busy[k].clear();
+            stage->dst_busy[k].clear();
+        }
+
+        while (true) {
+            uint32_t i;
+            while (!stage->input.pop(i)) {
+                std::this_thread::yield();
+            }
+            if (i != FASTPASS_PIPELINE_END) {
+                FastpassFlow* f = (*flows)[i];
+                uint32_t src = f->src->id;
+                uint32_t dst = f->dst->id;
+                for (uint32_t k = stage->first_slot; k < stage->last_slot && (*demand)[i] > 0; k++) {
+                    if (stage->src_busy[k].test(src) || stage->dst_busy[k].test(dst)) {
+                        continue;
+                    }
+                    stage->src_busy[k].set(src);
+                    stage->dst_busy[k].set(dst);
+                    (*slots)[src * FASTPASS_EPOCH_PKTS + k] = f;
+                    (*demand)[i]--;
+                }
+            }
+            if (next != NULL) {
+                while (!next->input.push(i)) {
+                    std::this_thread::yield();
+                }
+            }
+            if (i == FASTPASS_PIPELINE_END) {
+                break;
+            }
+        }
+        if (next == NULL) {
+            epoch_done.store(seen, std::memory_order_release);
+        }
+    }
+}
@@ -0,0 +1,106 @@
+#ifndef FASTPASS_ALLOCATOR_H
+#define FASTPASS_ALLOCATOR_H
+
+#include <set>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include "../coresim/spsc_queue.h"
+
+#include "../run/params.h"
+
+class FastpassFlow;
+
+// fewest remaining packets first, then flow id
+class FastpassFlowComparator {
+    public:
+        bool operator() (FastpassFlow* a, FastpassFlow* b) const;
+};
+
+// one bit per host
+class HostBitset {
+    public:
+        void resize(uint32_t num_hosts);
+        void clear();
+        bool test(uint32_t h) const { return (words[h >> 6] >> (h & 63)) & 1; }
+        void set(uint32_t h) { words[h >> 6] |= 1ULL << (h & 63); }
+        std::vector<uint64_t> words;
+};
+
+class FastpassPipeline;
+
+/*
+ * Timeslot allocation for the Fastpass arbiter. Flows with packets to place
+ * sit in the request set of their source. A timeslot merges the request
+ * sets in order; a source drops out of the merge once it has the slot, so
+ * its other flows are never looked at, and destinations in use are kept in
+ * a bitset.
+ *
+ * With fastpass_pipeline_threads set, the epoch is instead allocated by a
+ * pipeline of threads, each owning some of its timeslots: flows go through
+ * the slots in the order fixed at the start of the epoch and take every
+ * slot where both ends are free, as in the Fastpass paper.
+ */
+class FastpassAllocator {
+    public:
+        FastpassAllocator(uint32_t num_hosts);
+        ~FastpassAllocator();
+        void update_request(FastpassFlow* f);   // after arbiter_remaining_num_pkts changes
+        bool has_requests();
+        // slots[src * FASTPASS_EPOCH_PKTS + i] is the flow src sends in timeslot i
+        void allocate_epoch(std::vector<FastpassFlow*>& slots);
+
+    private:
+        void allocate_timeslot(uint32_t slot, std::vector<FastpassFlow*>& slots);
+        void remove_request(FastpassFlow* f);
+        void add_request(FastpassFlow* f);
+
+        uint32_t num_hosts;
+        std::vector<std::set<FastpassFlow*, FastpassFlowComparator> > requests;
+        std::set<uint32_t> active_srcs;
+        uint32_t num_requests;
+        HostBitset dst_busy;
+        std::vector<FastpassFlow*> allocated;
+        FastpassPipeline* pipeline;
+};
+
+#define FASTPASS_PIPELINE_QUEUE 4096
+#define FASTPASS_PIPELINE_END 0xffffffff
+
+// one stage: a thread allocating a contiguous range of the epoch's timeslots
+struct FastpassPipelineStage {
+    uint32_t first_slot;
+    uint32_t last_slot;
+    HostBitset src_busy[FASTPASS_EPOCH_PKTS];
+    HostBitset dst_busy[FASTPASS_EPOCH_PKTS];
+    SpscQueue<uint32_t, FASTPASS_PIPELINE_QUEUE> input;
+    std::thread worker;
+};
+
+class FastpassPipeline {
+    public:
+        FastpassPipeline(uint32_t num_hosts, uint32_t num_threads);
+        ~FastpassPipeline();
+        // flows in priority order; demand[i] is decreased by the slots flows[i] gets
+        void allocate_epoch(std::vector<FastpassFlow*>& flows, std::vector<int>& demand,
+                std::vector<FastpassFlow*>& slots);
+
+    private:
+        void run_stage(uint32_t s);
+
+        std::vector<FastpassPipelineStage*> stages;
+        std::vector<FastpassFlow*>* flows;
+        std::vector<int>* demand;
+        std::vector<FastpassFlow*>* slots;
+
+        std::mutex lock;
+        std::condition_variable epoch_start;
+        uint64_t epoch;
+        bool shutdown;
+        std::atomic<uint64_t> epoch_done;
+};
+
+#endif
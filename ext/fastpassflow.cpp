@@ -22,8 +22,10 @@ FastpassFlow::FastpassFlow(
         Host *d
         ) : Flow(id, start_time, size, s, d) {
     this->sender_remaining_num_pkts = this->size_in_pkt;
+    this->arbiter_remaining_num_pkts = 0;
     this->arbiter_received_rts = false;
     this->arbiter_finished = false;
+    this->arbiter_queued_remaining = -1;
     this->sender_acked_count = 0;
     this->sender_acked_until = 0;
     this->sender_last_pkt_sent = -1;
@@ -143,6 +145,10 @@ ArbiterProcessingEvent::ArbiterProcessingEvent(double time, FastpassArbiter* a)
 ArbiterProcessingEvent::~ArbiterProcessingEvent() {
 }
 
+uint32_t ArbiterProcessingEvent::target_id() {
+    return arbiter->id;
+}
+
 void ArbiterProcessingEvent::process_event() {
     this->arbiter->arbiter_proc_evt = NULL;
     this->arbiter->schedule_epoch();
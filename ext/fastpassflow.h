@@ -31,6 +31,7 @@ public:
     int arbiter_remaining_num_pkts;
     bool arbiter_received_rts;
     bool arbiter_finished;
+    int arbiter_queued_remaining;   // key in the arbiter's request set, -1 when not queued
 };
 
 #define FASTPASS_FLOW_PROCESSING 15
@@ -39,6 +40,7 @@ class FastpassFlowProcessingEvent : public Event {
         FastpassFlowProcessingEvent(double time, FastpassFlow *flow);
         ~FastpassFlowProcessingEvent();
         void process_event();
+        uint32_t target_id();
         FastpassFlow* flow;
 };
 
@@ -48,6 +50,7 @@ class FastpassTimeoutEvent : public Event {
         FastpassTimeoutEvent(double time, FastpassFlow *flow);
         ~FastpassTimeoutEvent();
         void process_event();
+        uint32_t target_id();
         FastpassFlow* flow;
 };
 
@@ -17,11 +17,6 @@ extern void add_to_event_queue(Event*);
 extern DCExpParams params;
 extern Topology *topology;
 
-bool FastpassFlowComparator::operator() (FastpassFlow* a, FastpassFlow* b) {
-    return a->arbiter_remaining_num_pkts > b->arbiter_remaining_num_pkts;
-}
-
-
 FastpassEpochSchedule::FastpassEpochSchedule(double s) {
     this->start_time = s;
     for(int i = 0; i < FASTPASS_EPOCH_PKTS; i++)
@@ -56,60 +51,16 @@ void FastpassHost::receive_schedule_pkt(FastpassSchedulePkt* pkt) {
 }
 
 
-FastpassArbiter::FastpassArbiter(uint32_t id, double rate, uint32_t queue_type) : Host(id, rate, queue_type, FASTPASS_ARBITER) {}
+FastpassArbiter::FastpassArbiter(uint32_t id, double rate, uint32_t queue_type)
+    : Host(id, rate, queue_type, FASTPASS_ARBITER), allocator(params.num_hosts) {
+    this->arbiter_proc_evt = NULL;
+    this->epoch_slots.resize(params.num_hosts * FASTPASS_EPOCH_PKTS);
+}
 
 void FastpassArbiter::start_arbiter() {
     this->schedule_proc_evt(1.0);
 }
 
-std::map<int, FastpassFlow*> FastpassArbiter::schedule_timeslot()
-{
-    std::map<int, FastpassFlow*> schedule;
-    std::set<int> sender_used;
-    std::set<int> receiver_used;
-
-
-    std::queue<FastpassFlow*> flows_tried;
-    while(!sending_flows.empty())
-    {
-        FastpassFlow* f = sending_flows.top();
-        sending_flows.pop();
-        if(f->arbiter_finished){
-            continue;
-        }
-        bool sender_free = sender_used.count(f->src->id) == 0;
-        bool receiver_free = receiver_used.count(f->dst->id) == 0;
-        if(debug_flow(f->id) && get_current_time() >= 1.03000023262123){
-            std::cout << get_current_time() << " attempting schedule flow " << f->id << " " << f->src->id << "->" << f->dst->id << " for epoch " <<
-                get_current_time() + params.fastpass_epoch_time << " s_free" << sender_free << " r_free" << receiver_free << " arb_remaining " << f->arbiter_remaining_num_pkts <<
-                " sender_last_pkt_sent " << f->sender_last_pkt_sent << "/" << f->size_in_pkt << "\n";
-            if(!sender_free)
-                std::cout << "sender used by " << schedule[f->src->id]->id << " " << schedule[f->src->id]->src->id << "->" << schedule[f->src->id]->dst->id << "\n";
-        }
-
-        if(f->arbiter_remaining_num_pkts > 0 && sender_free && receiver_free){
-            f->arbiter_remaining_num_pkts--;
-            sender_used.insert(f->src->id);
-            receiver_used.insert(f->dst->id);
-            schedule[f->src->id] = f;
-            if(debug_flow(f->id))
-                std::cout << get_current_time() << " scheduled flow " << f->id << " for epoch " << get_current_time() + params.fastpass_epoch_time <<
-                    " remaining pkts " << f->arbiter_remaining_num_pkts << "\n";
-        }
-        flows_tried.push(f);
-    }
-
-    while(!flows_tried.empty())
-    {
-        sending_flows.push(flows_tried.front());
-        flows_tried.pop();
-    }
-
-
-    return schedule;
-}
-
-
 void FastpassArbiter::schedule_proc_evt(double time) {
     if (this->arbiter_proc_evt != NULL) {
         this->arbiter_proc_evt->cancelled = true;
@@ -123,35 +74,26 @@ void FastpassArbiter::schedule_epoch() {
     if (total_finished_flows >= params.num_flows_to_run)
         return;
 
-    std::vector<FastpassEpochSchedule*> schedules;
-    for (uint i = 0; i < params.num_hosts; i++){
-        schedules.push_back(new FastpassEpochSchedule(get_current_time() + params.fastpass_epoch_time));
-    }
-
-
-
-    for(int i = 0; i < FASTPASS_EPOCH_PKTS; i++){
-        if(this->sending_flows.size() > 0){
-            std::map<int, FastpassFlow*> one_time_slot = schedule_timeslot();
-
-            for(auto iter = one_time_slot.begin(); iter != one_time_slot.end(); ++iter)
-            {
-                int sender = iter->first;
-                FastpassFlow* f = iter->second;
-                schedules[sender]->schedule[i] = f;
-            }
-        }
+    std::fill(epoch_slots.begin(), epoch_slots.end(), (FastpassFlow*) NULL);
+    if (allocator.has_requests()) {
+        allocator.allocate_epoch(epoch_slots);
     }
 
+    this->queue->settle();
     assert(this->queue->limit_bytes - this->queue->bytes_in_queue >= 144 * 40);
 
-    for(int i = 0; i < params.num_hosts; i++)
+    double epoch_start = get_current_time() + params.fastpass_epoch_time;
+    for(uint32_t i = 0; i < params.num_hosts; i++)
     {
-        FastpassFlow* f = schedules[i]->get_sender();
-        if(f)
-            f->send_schedule_pkt(schedules[i]);
-        else
-            delete schedules[i];
+        FastpassFlow** slots = &epoch_slots[i * FASTPASS_EPOCH_PKTS];
+        for (int j = 0; j < FASTPASS_EPOCH_PKTS; j++) {
+            if (slots[j]) {
+                FastpassEpochSchedule* schedule = new FastpassEpochSchedule(epoch_start);
+                std::copy(slots, slots + FASTPASS_EPOCH_PKTS, schedule->schedule);
+                schedule->get_sender()->send_schedule_pkt(schedule);
+                break;
+            }
+        }
     }
 
     //schedule next arbiter proc evt
@@ -160,18 +102,16 @@ void FastpassArbiter::schedule_epoch() {
 
 void FastpassArbiter::receive_rts(FastpassRTS* rts)
 {
-    if(!((FastpassFlow*)rts->flow)->arbiter_received_rts)
-    {
-        ((FastpassFlow*) rts->flow)->arbiter_received_rts = true;
-        dynamic_cast<FastpassTopology*>(topology)->arbiter->sending_flows.push((FastpassFlow*)rts->flow);
-    }
+    FastpassFlow* f = (FastpassFlow*) rts->flow;
+    f->arbiter_received_rts = true;
 
     if(rts->remaining_num_pkts < 0){
-        ((FastpassFlow*)rts->flow)->arbiter_remaining_num_pkts = 0;
-        ((FastpassFlow*)rts->flow)->arbiter_finished = true;
+        f->arbiter_remaining_num_pkts = 0;
+        f->arbiter_finished = true;
     }
     else
-        ((FastpassFlow*)rts->flow)->arbiter_remaining_num_pkts = rts->remaining_num_pkts;
+        f->arbiter_remaining_num_pkts = rts->remaining_num_pkts;
+    allocator.update_request(f);
 }
 
 
@@ -183,6 +123,10 @@ FastpassFlowProcessingEvent::FastpassFlowProcessingEvent(double time, FastpassFl
 FastpassFlowProcessingEvent::~FastpassFlowProcessingEvent() {
 }
 
+uint32_t FastpassFlowProcessingEvent::target_id() {
+    return flow->id;
+}
+
 void FastpassFlowProcessingEvent::process_event() {
     this->flow->send_data_pkt();
 }
@@ -195,6 +139,10 @@ FastpassTimeoutEvent::FastpassTimeoutEvent(double time, FastpassFlow* f) : Event
 FastpassTimeoutEvent::~FastpassTimeoutEvent() {
 }
 
+uint32_t FastpassTimeoutEvent::target_id() {
+    return flow->id;
+}
+
 void FastpassTimeoutEvent::process_event() {
     this->flow->fastpass_timeout();
 }
@@ -1,29 +1,23 @@
 #ifndef FASTPASS_HOST_H
 #define FASTPASS_HOST_H
 
-#include <map>
-#include <set>
-
 #include "../coresim/node.h"
 #include "../coresim/packet.h"
 #include "../coresim/event.h"
 
 #include "../run/params.h"
 
+#include "fastpassallocator.h"
+
 class ArbiterProcessingEvent;
 class FastpassFlow;
 
-class FastpassFlowComparator {
-    public:
-        bool operator() (FastpassFlow* a, FastpassFlow* b);
-};
-
 class FastpassEpochSchedule {
     public:
         FastpassEpochSchedule(double s);
         FastpassFlow* get_sender();
         double start_time;
-        std::map<int, FastpassFlow*> schedule;
+        FastpassFlow* schedule[FASTPASS_EPOCH_PKTS];
 };
 
 class FastpassHost : public Host {
@@ -37,12 +31,12 @@ class FastpassArbiter : public Host {
         FastpassArbiter(uint32_t id, double rate, uint32_t queue_type);
         void start_arbiter();
         void schedule_proc_evt(double time);
-        std::map<int, FastpassFlow*> schedule_timeslot();
         void schedule_epoch();
         void receive_rts(FastpassRTS* rts);
 
         ArbiterProcessingEvent* arbiter_proc_evt;
-        std::priority_queue<FastpassFlow*, std::vector<FastpassFlow*>, FastpassFlowComparator> sending_flows;
+        FastpassAllocator allocator;
+        std::vector<FastpassFlow*> epoch_slots;    // FASTPASS_EPOCH_PKTS per host
 };
 
 #define ARBITER_PROCESSING 14
@@ -51,6 +45,7 @@ class ArbiterProcessingEvent : public Event {
         ArbiterProcessingEvent(double time, FastpassArbiter *host);
         ~ArbiterProcessingEvent();
         void process_event();
+        uint32_t target_id();
         FastpassArbiter* arbiter;
 };
 
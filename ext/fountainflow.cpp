@@ -77,12 +77,24 @@ void FountainFlowWithSchedulingHost::send_pending_data() {
         return;
     }
 
-    Packet *p = this->send(next_seq_no);
-    next_seq_no += mss;
+    // fountain coded: any packets will do until the ACK comes
+    SchedulingHost* host = (SchedulingHost*) src;
+    host->pacer.start_train();
+    uint32_t train = host->pacer.train_length(params.host_pacer_train);
+    for (uint32_t i = 0; i < train; i++) {
+        this->send(next_seq_no);
+        next_seq_no += mss;
+    }
 
-    double td = src->queue->get_transmission_delay(p->size);
-    ((SchedulingHost*) src)->host_proc_event = new HostProcessingEvent(get_current_time() + td, (SchedulingHost*) src);
-    add_to_event_queue(((SchedulingHost*) src)->host_proc_event);    
+    host->host_proc_event = new HostProcessingEvent(host->pacer.train_end, host);
+    add_to_event_queue(host->host_proc_event);
+}
+
+Packet* FountainFlowWithSchedulingHost::send(uint32_t seq) {
+    Packet *p = new Packet(get_current_time(), this, seq, 1, mss + hdr_size, src, dst);
+    total_pkt_sent++;
+    ((SchedulingHost*) src)->pacer.transmit(p);
+    return p;
 }
 
 void FountainFlowWithSchedulingHost::receive(Packet *p) {
@@ -19,6 +19,7 @@ public:
     FountainFlowWithSchedulingHost(uint32_t id, double start_time, uint32_t size, Host *s, Host *d);
     virtual void start_flow();
     virtual void send_pending_data();
+    virtual Packet* send(uint32_t seq);
     virtual void receive(Packet *p);
 };
 
@@ -10,79 +10,177 @@ extern void add_to_event_queue(Event *);
 extern uint32_t num_outstanding_packets;
 extern IdealArbiter* ideal_arbiter;
 
+bool IdealFlowComparator::operator() (IdealFlow* a, IdealFlow* b) const {
+    if (a->arbiter_key != b->arbiter_key) {
+        return a->arbiter_key < b->arbiter_key;
+    }
+    return a->id < b->id;
+}
+
+// candidates pop in SRPT order
+static bool candidate_after(const IdealCandidate& a, const IdealCandidate& b) {
+    if (a.key != b.key) {
+        return a.key > b.key;
+    }
+    return a.id > b.id;
+}
+
+static uint32_t remaining(IdealFlow* f) {
+    return f->acked < f->size ? f->size - f->acked : 0;
+}
+
 IdealArbiter::IdealArbiter() {
-    active_flows = new std::vector<IdealFlow*>();
-    srcs = new std::array<bool, 144>();
-    dsts = new std::array<bool, 144>();
+    num_hosts = params.num_hosts;
+    flows.resize(2 * num_hosts);
+    matched.assign(2 * num_hosts, NULL);
+    hosts.assign(num_hosts, NULL);
+}
 
-    assert(srcs->size() == params.num_hosts);
+uint32_t IdealArbiter::src_endpoint(IdealFlow* f) {
+    return f->src->id;
 }
 
-bool compareFlows(IdealFlow* i, IdealFlow* j) {
-    uint32_t i_remain = i->acked - i->size;
-    uint32_t j_remain = j->acked - j->size;
-    return i_remain > j_remain;
+uint32_t IdealArbiter::dst_endpoint(IdealFlow* f) {
+    return num_hosts + f->dst->id;
 }
 
-void IdealArbiter::flow_arrival(IdealFlow* f) {
-    for (auto it = active_flows->begin(); it != active_flows->end(); it++) {
-        assert(*it != f);
-    }
+// flows are keyed by arbiter_key, so it only changes while out of the sets
+void IdealArbiter::add_flow(IdealFlow* f) {
+    f->arbiter_key = remaining(f);
+    flows[src_endpoint(f)].insert(f);
+    flows[dst_endpoint(f)].insert(f);
+}
 
-    active_flows->push_back(f);
-    std::stable_sort(active_flows->begin(), active_flows->end(), compareFlows);
+void IdealArbiter::remove_flow(IdealFlow* f) {
+    flows[src_endpoint(f)].erase(f);
+    flows[dst_endpoint(f)].erase(f);
+}
 
-    compute_schedule();
+// whether the matched flow holding one of f's endpoints keeps it
+bool IdealArbiter::blocks(IdealFlow* holder, IdealFlow* f) {
+    if (holder == NULL) {
+        return false;
+    }
+    if (holder->arbiter_key != remaining(holder)) {
+        remove_flow(holder);
+        add_flow(holder);
+    }
+    return IdealFlowComparator()(holder, f);
 }
 
-void IdealArbiter::flow_finished(IdealFlow* f) {
-    assert(f->sent >= f->size);
-    ((IdealHost*) f->src)->active_flow = NULL;
-    for (auto it = active_flows->begin(); it != active_flows->end(); it++) {
-        if (*it == f) {
-            active_flows->erase(it);
-            compute_schedule();
-            return;
-        }
+void IdealArbiter::push_candidate(IdealFlow* f, uint32_t endpoint) {
+    IdealCandidate c;
+    c.key = f->arbiter_key;
+    c.id = f->id;
+    c.flow = f;
+    c.endpoint = endpoint;
+    candidates.push_back(c);
+    std::push_heap(candidates.begin(), candidates.end(), candidate_after);
+}
+
+// the next flow at a free endpoint after the given one, which may have left
+void IdealArbiter::push_next(uint32_t endpoint, IdealFlow* after) {
+    auto it = flows[endpoint].upper_bound(after);
+    if (it != flows[endpoint].end()) {
+        push_candidate(*it, endpoint);
     }
 }
 
-void IdealArbiter::compute_schedule() {
-    srcs->fill(false);
-    dsts->fill(false);
+void IdealArbiter::match(IdealFlow* f) {
+    matched[src_endpoint(f)] = f;
+    matched[dst_endpoint(f)] = f;
+    changed_srcs.push_back(f->src->id);
+}
+
+void IdealArbiter::unmatch(IdealFlow* f) {
+    matched[src_endpoint(f)] = NULL;
+    matched[dst_endpoint(f)] = NULL;
+    changed_srcs.push_back(f->src->id);
+}
+
+/*
+ * Candidates are handled in priority order and only ever lead to lower
+ * priority ones, so each flow is decided after every flow that could block
+ * it. A candidate found at a freed endpoint that is already taken again ends
+ * that walk; one that is blocked at its other endpoint passes the walk on.
+ */
+void IdealArbiter::update_matching() {
+    while (!candidates.empty()) {
+        std::pop_heap(candidates.begin(), candidates.end(), candidate_after);
+        IdealCandidate c = candidates.back();
+        candidates.pop_back();
+        IdealFlow* f = c.flow;
+        if (c.endpoint != IDEAL_NO_ENDPOINT && matched[c.endpoint] != NULL) {
+            continue;
+        }
 
-    for (auto it = active_flows->begin(); it != active_flows->end(); it++) {
-        IdealFlow* f = (IdealFlow*) *it;
-        if (f->finished) {
-            if (((IdealHost*) f->src)->active_flow == f) {
-                ((IdealHost*) f->src)->active_flow = NULL;
+        IdealFlow* src_holder = matched[src_endpoint(f)];
+        IdealFlow* dst_holder = matched[dst_endpoint(f)];
+        if (!blocks(src_holder, f) && !blocks(dst_holder, f)) {
+            // displaced flows free their other endpoint
+            if (src_holder != NULL) {
+                unmatch(src_holder);
+                push_next(dst_endpoint(src_holder), src_holder);
             }
-            it = active_flows->erase(it);
-            if (it == active_flows->end()) {
-                break;
+            if (dst_holder != NULL && dst_holder != src_holder) {
+                unmatch(dst_holder);
+                push_next(src_endpoint(dst_holder), dst_holder);
             }
+            match(f);
         }
-        if (!srcs->at(f->src->id) && !dsts->at(f->dst->id)) {
-            auto previous = ((IdealHost*) f->src)->active_flow;
-            if (previous != NULL && 
-                previous->id != f->id && 
-                ((IdealHost*) f->src)->host_proc_event != NULL
-            ) {
-                // new flow
-                ((IdealHost*) f->src)->host_proc_event->cancelled = true;
-                ((IdealHost*) f->src)->host_proc_event = NULL;
-            }
-            ((IdealHost*) f->src)->active_flow = f;
+        else if (c.endpoint != IDEAL_NO_ENDPOINT) {
+            push_next(c.endpoint, f);
+        }
+    }
+    update_hosts();
+}
 
-            srcs->at(f->src->id) = true;
-            dsts->at(f->dst->id) = true;
-                
-            if (((IdealHost*) f->src)->host_proc_event == NULL || ((IdealHost*) f->src)->host_proc_event->cancelled) {
-                ((IdealHost*) f->src)->host_proc_event = new HostProcessingEvent(get_current_time(), (IdealHost*) f->src);
-                add_to_event_queue(((IdealHost*) f->src)->host_proc_event);
-            }
+// points the sources whose match changed at their new flow
+void IdealArbiter::update_hosts() {
+    for (uint32_t i = 0; i < changed_srcs.size(); i++) {
+        IdealHost* host = hosts[changed_srcs[i]];
+        IdealFlow* f = matched[changed_srcs[i]];
+        IdealFlow* previous = host->active_flow;
+        if (previous == f) {
+            continue;
+        }
+        if (previous != NULL && host->host_proc_event != NULL) {
+            host->host_proc_event->cancelled = true;
+            host->host_proc_event = NULL;
+        }
+        host->active_flow = f;
+        if (f != NULL && (host->host_proc_event == NULL || host->host_proc_event->cancelled)) {
+            host->host_proc_event = new HostProcessingEvent(get_current_time(), host);
+            add_to_event_queue(host->host_proc_event);
         }
     }
+    changed_srcs.clear();
+}
+
+void IdealArbiter::flow_arrival(IdealFlow* f) {
+    assert(!f->arbiter_active);
+    assert(f->src->id < num_hosts && f->dst->id < num_hosts);
+    f->arbiter_active = true;
+    hosts[f->src->id] = (IdealHost*) f->src;
+    add_flow(f);
+    push_candidate(f, IDEAL_NO_ENDPOINT);
+    update_matching();
+}
+
+void IdealArbiter::flow_finished(IdealFlow* f) {
+    assert(f->sent >= f->size);
+    ((IdealHost*) f->src)->active_flow = NULL;
+    if (!f->arbiter_active) {
+        return;
+    }
+    f->arbiter_active = false;
+    remove_flow(f);
+    if (matched[src_endpoint(f)] == f) {
+        unmatch(f);
+        push_next(src_endpoint(f), f);
+        push_next(dst_endpoint(f), f);
+    }
+    update_matching();
 }
 
 IdealHost::IdealHost(uint32_t id, double rate, uint32_t queue_type) : SchedulingHost(id, rate, queue_type) {
@@ -101,10 +199,17 @@ void IdealHost::send() {
     if (active_flow != NULL && !active_flow->finished) {
         assert(active_flow->src == this);
 
-        host_proc_event = new HostProcessingEvent(get_current_time() + td + INFINITESIMAL_TIME, this);
+        // the train ends early if the arbiter moves this host to another flow
+        IdealFlow* f = active_flow;
+        uint32_t pkts_left = f->sent < f->size ? (f->size - f->sent + f->mss - 1) / f->mss : 1;
+        pacer.start_train();
+        uint32_t train = pacer.train_length(pkts_left);
+        host_proc_event = new HostProcessingEvent(get_current_time() + train * td + INFINITESIMAL_TIME, this);
         add_to_event_queue(host_proc_event);
-        
-        active_flow->send_pending_data();
+
+        for (uint32_t i = 0; i < train && active_flow == f; i++) {
+            f->send_pending_data();
+        }
     }
 }
 
@@ -116,6 +221,8 @@ IdealFlow::IdealFlow(uint32_t id, double start_time, uint32_t size, Host *s, Hos
     received = 0;
     acked = 0;
     sent = 0;
+    arbiter_key = 0;
+    arbiter_active = false;
 }
 
 void IdealFlow::start_flow() {
@@ -129,6 +236,14 @@ void IdealFlow::handle_timeout() {
     }
 }
 
+Packet* IdealFlow::send(uint32_t seq) {
+    uint32_t pkt_size = seq + mss > size ? size - seq + hdr_size : mss + hdr_size;
+    Packet* p = new Packet(get_current_time(), this, seq, get_priority(seq), pkt_size, src, dst);
+    total_pkt_sent++;
+    ((IdealHost*) src)->pacer.transmit(p);
+    return p;
+}
+
 void IdealFlow::send_pending_data() {
     if (finished) {
         cancel_retx_event();
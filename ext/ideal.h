@@ -6,20 +6,69 @@
 
 #include "../run/params.h"
 
-#include <array>
+#include <set>
+#include <vector>
 
 class IdealFlow;
+class IdealHost;
 
-class IdealArbiter {
+// SRPT order: fewest bytes left to ack first, then flow id
+class IdealFlowComparator {
     public:
-        std::vector<IdealFlow*>* active_flows;
-        std::array<bool, 144>* srcs;
-        std::array<bool, 144>* dsts;
+        bool operator() (IdealFlow* a, IdealFlow* b) const;
+};
+
+typedef std::set<IdealFlow*, IdealFlowComparator> IdealFlowSet;
+
+#define IDEAL_NO_ENDPOINT 0xffffffff
+
+// a flow to reconsider; endpoint is the source or destination it was found
+// at while walking the flows of a freed endpoint, IDEAL_NO_ENDPOINT for a
+// new arrival
+struct IdealCandidate {
+    uint32_t key;
+    uint32_t id;
+    IdealFlow* flow;
+    uint32_t endpoint;
+};
 
+/*
+ * Greedy maximal matching of sources to destinations in SRPT order, kept up
+ * to date incrementally. A flow is matched iff no higher priority matched
+ * flow shares its source or destination, so an arrival or departure only
+ * changes flows of lower priority sharing an endpoint with a flow whose
+ * match changed. Those are revisited in priority order, walking the ordered
+ * flow sets of the endpoints that came free.
+ *
+ * Endpoints are numbered src for sources and num_hosts + dst for
+ * destinations. A matched flow's key falls behind as it sends without
+ * changing the matching, so it is refreshed only when a flow challenges it.
+ */
+class IdealArbiter {
+    public:
         IdealArbiter();
         void flow_arrival(IdealFlow* f);
         void flow_finished(IdealFlow* f);
-        void compute_schedule();
+
+    private:
+        uint32_t src_endpoint(IdealFlow* f);
+        uint32_t dst_endpoint(IdealFlow* f);
+        void add_flow(IdealFlow* f);
+        void remove_flow(IdealFlow* f);
+        bool blocks(IdealFlow* holder, IdealFlow* f);
+        void push_candidate(IdealFlow* f, uint32_t endpoint);
+        void push_next(uint32_t endpoint, IdealFlow* after);
+        void match(IdealFlow* f);
+        void unmatch(IdealFlow* f);
+        void update_matching();
+        void update_hosts();
+
+        uint32_t num_hosts;
+        std::vector<IdealFlowSet> flows;        // per endpoint
+        std::vector<IdealFlow*> matched;        // per endpoint, NULL when free
+        std::vector<IdealHost*> hosts;
+        std::vector<IdealCandidate> candidates; // heap, highest priority on top
+        std::vector<uint32_t> changed_srcs;
 };
 
 class IdealHost : public SchedulingHost {
@@ -47,9 +96,13 @@ class IdealFlow : public Flow {
 
         uint32_t received; // Receiver side
 
+        uint32_t arbiter_key;   // bytes left to ack when last indexed by the arbiter
+        bool arbiter_active;
+
         virtual void start_flow();
         virtual void handle_timeout();
         virtual void send_pending_data();
+        virtual Packet* send(uint32_t seq);
         virtual void receive(Packet* p);
         virtual uint32_t get_priority(uint32_t seq);
 };
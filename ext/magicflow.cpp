@@ -47,24 +47,16 @@ Packet* MagicFlow::send(uint32_t seq) {
     //priority = this->remaining_pkt();
     Packet *p = new Packet(get_current_time(), this, seq, priority, mss + hdr_size, src, dst);
     total_pkt_sent++;
-    add_to_event_queue(new PacketQueuingEvent(get_current_time(), p, src->queue));
+    ((SchedulingHost*) src)->pacer.transmit(p);
     return p;
 }
 
 void MagicFlow::send_pending_data() {
-    Packet *p = this->send(next_seq_no);
+    this->send(next_seq_no);
     next_seq_no += mss;
     this->send_count++;
     assert(this->remaining_pkt_this_round > 0);
     this->remaining_pkt_this_round--;
-
-    if(((SchedulingHost*) src)->host_proc_event == NULL || ((MagicHost*) src)->is_host_proc_event_a_timeout){
-        if(((SchedulingHost*) src)->host_proc_event)
-            ((SchedulingHost*) src)->host_proc_event->cancelled = true;
-        double td = src->queue->get_transmission_delay(p->size);
-        ((SchedulingHost*) src)->host_proc_event = new HostProcessingEvent(get_current_time() + td, (SchedulingHost*) src);
-        add_to_event_queue(((SchedulingHost*) src)->host_proc_event);
-    }
 }
 
 void MagicFlow::receive(Packet *p) {
@@ -72,7 +64,13 @@ void MagicFlow::receive(Packet *p) {
         return;
     }
     if (p->type == NORMAL_PACKET) {
+        // the sender orders its flows by remaining_pkt()
+        auto& sending = ((MagicHost*) src)->active_sending_flows.ready;
+        bool was_ready = sending.erase(this) > 0;
         received_count++;
+        if (was_ready) {
+            sending.insert(this);
+        }
         received_bytes += (p->size - hdr_size);
         //only send one ack per bdp
         //        if (received_count == size_in_pkt){
@@ -21,6 +21,10 @@ MagicHostScheduleEvent::MagicHostScheduleEvent(double time, MagicHost *h) : Even
 MagicHostScheduleEvent::~MagicHostScheduleEvent() {
 }
 
+uint32_t MagicHostScheduleEvent::target_id() {
+    return host->id;
+}
+
 void MagicHostScheduleEvent::process_event() {
     //std::cout << "calling schd() at event.cpp 369 for host" << this->host->id << "\n";
     this->host->schedule();
@@ -37,7 +41,7 @@ bool has_higher_priority(MagicFlow* a, MagicFlow* b) {
         return false;
 }
 
-bool MagicHostFlowComparator::operator() (MagicFlow* a, MagicFlow* b) {
+bool MagicHostFlowComparator::operator() (MagicFlow* a, MagicFlow* b) const {
     // use FIFO ordering since all flows are same size
     if(a->remaining_pkt() > b->remaining_pkt())
         return true;
@@ -68,7 +72,7 @@ void MagicHost::start(Flow* f) {
 
     ((MagicFlow*)f)->last_pkt_sent_at = get_current_time();
 
-    this->active_sending_flows.push((MagicFlow*)f);
+    this->active_sending_flows.push((MagicFlow*)f, ((MagicFlow*)f)->ack_timeout, get_current_time());
 
 
     this->schedule();
@@ -86,22 +90,21 @@ void MagicHost::schedule() {
         bool scheduled = false;
         double min_finish_time = 999999;
 
-        std::queue<Flow*> flows_tried;
+        // flows waiting for an ack are not looked at
+        active_sending_flows.release(get_current_time());
+        auto& ready = active_sending_flows.ready;
 
         bool has_short_flow_to_delay = false;
-        while(!active_sending_flows.empty()){
-            MagicFlow* f = (MagicFlow*)active_sending_flows.top();
-            active_sending_flows.pop();
+        auto it = ready.begin();
+        while(it != ready.end()){
+            MagicFlow* f = *it;
 
-            if(f->finished)
+            if(f->finished){
+                it = ready.erase(it);
                 continue;
-
-            if (f->ack_timeout > get_current_time()){
-                if(f->ack_timeout < min_finish_time )
-                    min_finish_time = f->ack_timeout;
-                flows_tried.push(f);
             }
-            else if(((MagicHost*)(f->dst))->recv_busy_until <= get_current_time() + f->get_propa_time() * params.magic_trans_slack
+
+            if(((MagicHost*)(f->dst))->recv_busy_until <= get_current_time() + f->get_propa_time() * params.magic_trans_slack
                     || f->size_in_pkt < ((MagicHost*)(f->dst))->flow_receiving->size_in_pkt
                    ){
                 //schedule the current flow
@@ -117,6 +120,7 @@ void MagicHost::schedule() {
                 int pkt_to_schd = std::max((unsigned)1, std::min((unsigned)params.reauth_limit, f->remaining_pkt()));
                 f->remaining_pkt_this_round = pkt_to_schd;
                 ((MagicHost*)(f->dst))->recv_busy_until = get_current_time() + f->get_propa_time() + 0.0000012 * pkt_to_schd;
+                ready.erase(it);
                 scheduled = true;
                 break;
             }
@@ -128,24 +132,25 @@ void MagicHost::schedule() {
                     min_finish_time = ((MagicHost*)(f->dst))->recv_busy_until - f->get_propa_time()  * params.magic_trans_slack;
                 }
 
-                flows_tried.push(f);
+                it++;
 
                 if(params.magic_delay_scheduling){
                     double slack = ((MagicHost*)(f->dst))->recv_busy_until - (get_current_time() + f->get_propa_time() * params.magic_trans_slack);
                     if(f->size_in_pkt < 10 && slack < params.reauth_limit * 0.0000012 * 0.9){
                         has_short_flow_to_delay = true;
                     }
-                    if(active_sending_flows.size() > 0 && active_sending_flows.top()->size_in_pkt > 10 && has_short_flow_to_delay)
+                    if(it != ready.end() && (*it)->size_in_pkt > 10 && has_short_flow_to_delay)
                         break;
                 }
             }
         }
 
-        //push flows back
-        while(!flows_tried.empty()){
-            Flow* f = flows_tried.front();
-            flows_tried.pop();
-            active_sending_flows.push((MagicFlow*)f);
+        if(!scheduled){
+            auto& blocked = active_sending_flows.blocked;
+            while(!blocked.empty() && blocked.top().flow->finished)
+                blocked.pop();
+            if(!blocked.empty() && blocked.top().time < min_finish_time)
+                min_finish_time = blocked.top().time;
         }
 
         //has sending flow, but no flow can be scheduled
@@ -188,19 +193,19 @@ void MagicHost::send() {
         if( ((MagicFlow*)(this->flow_sending))->send_count >= (int)ceil(this->flow_sending->size_in_pkt * 1) ){
             ((MagicFlow*)(this->flow_sending))->ack_timeout = get_current_time() + 0.0000095;
         }
-        this->active_sending_flows.push((MagicFlow*)(this->flow_sending));
+        this->active_sending_flows.push((MagicFlow*)(this->flow_sending), ((MagicFlow*)(this->flow_sending))->ack_timeout, get_current_time());
         this->reschedule();
     }
 
 
 
+    this->queue->settle();
     if(this->queue->busy){
         //queue busy, try send later
         if(this->host_proc_event == NULL){
-            QueueProcessingEvent *qpe = this->queue->queue_proc_event;
             uint32_t queue_size = this->queue->bytes_in_queue;
             double td = this->queue->get_transmission_delay(queue_size);
-            this->host_proc_event = new HostProcessingEvent(qpe->time + td + INFINITESIMAL_TIME, this);
+            this->host_proc_event = new HostProcessingEvent(this->queue->transmission_end() + td + INFINITESIMAL_TIME, this);
             this->is_host_proc_event_a_timeout = false;
             add_to_event_queue(this->host_proc_event);
         }
@@ -210,7 +215,19 @@ void MagicHost::send() {
         {
             if(debug_flow(this->flow_sending->id))
                 std::cout << get_current_time() << " flow " << this->flow_sending->id << " send pkt " << this->flow_sending->total_pkt_sent << "\n";
-            this->flow_sending->send_pending_data();
+            // the rest of the round goes out as one train
+            MagicFlow* f = (MagicFlow*)(this->flow_sending);
+            this->pacer.start_train();
+            uint32_t train = this->pacer.train_length(f->remaining_pkt_this_round);
+            for(uint32_t i = 0; i < train; i++)
+                f->send_pending_data();
+
+            if(this->host_proc_event == NULL || this->is_host_proc_event_a_timeout){
+                if(this->host_proc_event)
+                    this->host_proc_event->cancelled = true;
+                this->host_proc_event = new HostProcessingEvent(this->pacer.train_end, this);
+                add_to_event_queue(this->host_proc_event);
+            }
             this->is_host_proc_event_a_timeout = false;
         }
 
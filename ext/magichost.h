@@ -10,13 +10,14 @@
 #include "../coresim/event.h"
 
 #include "schedulinghost.h"
+#include "eligibilityqueue.h"
 
 class MagicFlow;
 class MagicHostScheduleEvent;
 
 class MagicHostFlowComparator {
     public:
-        bool operator() (MagicFlow* a, MagicFlow* b);
+        bool operator() (MagicFlow* a, MagicFlow* b) const;
 };
 
 class MagicFlowTimeoutComparator{
@@ -37,7 +38,8 @@ class MagicHost : public SchedulingHost {
         //Flow* flow_receiving;
         double recv_busy_until;
         bool is_host_proc_event_a_timeout;
-        std::priority_queue<MagicFlow*, std::vector<MagicFlow*>, MagicHostFlowComparator> active_sending_flows;
+        // blocked until ack_timeout
+        EligibilityQueue<MagicFlow, MagicHostFlowComparator> active_sending_flows;
         std::priority_queue<MagicFlow*, std::vector<MagicFlow*>, MagicFlowTimeoutComparator> sending_redundency;
         std::map<uint32_t, MagicFlow*> receiver_pending_flows;
 };
@@ -48,6 +50,7 @@ class MagicHostScheduleEvent : public Event {
         MagicHostScheduleEvent(double time, MagicHost *host);
         ~MagicHostScheduleEvent();
         void process_event();
+        uint32_t target_id();
         MagicHost *host;
 };
 
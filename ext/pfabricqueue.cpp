@@ -1,5 +1,6 @@
 #include "pfabricqueue.h"
 #include "../run/params.h"
+#include "../run/packet_trace.h"
 
 #include <iostream>
 #include <limits.h>
@@ -18,6 +19,9 @@ void PFabricQueue::enque(Packet *packet) {
     packets.push_back(packet);
     bytes_in_queue += packet->size;
     packet->last_enque_time = get_current_time();
+    if (packet_trace != NULL) {
+        packet_trace->add(this, packet, PACKET_TRACE_ENQUEUE);
+    }
     if (bytes_in_queue > limit_bytes) {
         uint32_t worst_priority = 0;
         uint32_t worst_index = 0;
@@ -64,6 +68,9 @@ Packet* PFabricQueue::deque() {
 
         p_departures += 1;
         b_departures += p->size;
+        if (packet_trace != NULL) {
+            packet_trace->add(this, p, PACKET_TRACE_DEQUEUE);
+        }
 
         p->total_queuing_delay += get_current_time() - p->last_enque_time;
 
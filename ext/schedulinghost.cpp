@@ -1,6 +1,8 @@
 #include <assert.h>
+#include <algorithm>
 
 #include "../coresim/flow.h"
+#include "../coresim/queue.h"
 #include "../coresim/packet.h"
 #include "../coresim/event.h"
 
@@ -23,6 +25,10 @@ HostProcessingEvent::~HostProcessingEvent() {
     }
 }
 
+uint32_t HostProcessingEvent::target_id() {
+    return host->id;
+}
+
 void HostProcessingEvent::process_event() {
     this->host->host_proc_event = NULL;
     this->host->send();
@@ -33,7 +39,38 @@ bool HostFlowComparator::operator() (Flow* a, Flow* b) {
     return a->start_time > b->start_time;
 }
 
-SchedulingHost::SchedulingHost(uint32_t id, double rate, uint32_t queue_type) : Host(id, rate, queue_type, SCHEDULING_HOST) {
+HostPacer::HostPacer(Queue *queue) {
+    this->queue = queue;
+    this->train_end = 0;
+    this->train = 1;
+}
+
+void HostPacer::start_train() {
+    train_end = get_current_time();
+    train = 1;
+}
+
+// the packet leaves the host train_end after the train started, ignoring
+// whatever else is queued at the NIC, as the per packet hosts did. A train
+// of one packet still goes through a PacketQueuingEvent, so it orders
+// same-time events as before the pacer.
+void HostPacer::transmit(Packet *p) {
+    if (train == 1) {
+        add_to_event_queue(new PacketQueuingEvent(get_current_time(), p, queue));
+    }
+    else {
+        queue->accept(p);
+    }
+    train_end += queue->get_transmission_delay(p->size);
+}
+
+// after start_train(): how many of pkts_ready packets the train sends
+uint32_t HostPacer::train_length(uint32_t pkts_ready) {
+    train = std::min(pkts_ready, params.host_pacer_train);
+    return train;
+}
+
+SchedulingHost::SchedulingHost(uint32_t id, double rate, uint32_t queue_type) : Host(id, rate, queue_type, SCHEDULING_HOST), pacer(queue) {
     this->host_proc_event = NULL;
 }
 
@@ -52,6 +89,7 @@ void SchedulingHost::send() {
         return;
     }
 
+    this->queue->settle();
     if (!this->queue->busy) {
         while (!this->sending_flows.empty() && (this->sending_flows.top())->finished) {
             this->sending_flows.pop();    
@@ -62,10 +100,9 @@ void SchedulingHost::send() {
         (this->sending_flows.top())->send_pending_data();
     }
     else {
-        QueueProcessingEvent *qpe = this->queue->queue_proc_event;
         uint32_t queue_size = this->queue->bytes_in_queue;
         double td = this->queue->get_transmission_delay(queue_size);
-        this->host_proc_event = new HostProcessingEvent(qpe->time + td, this);
+        this->host_proc_event = new HostProcessingEvent(this->queue->transmission_end() + td, this);
         add_to_event_queue(this->host_proc_event);
     }
 }
@@ -11,6 +11,25 @@
 class Flow;
 class HostProcessingEvent;
 
+/*
+ * A host picks a flow and sends a train of up to host_pacer_train of its
+ * packets back to back, then wakes once the train has been serialized,
+ * instead of after every packet. Trains go straight onto the NIC queue,
+ * without a PacketQueuingEvent each; a train of one packet, and so every
+ * packet with host_pacer_train 1 (the default), keeps its
+ * PacketQueuingEvent.
+ */
+class HostPacer {
+    public:
+        HostPacer(Queue *queue);
+        void start_train();
+        void transmit(Packet *p);
+        uint32_t train_length(uint32_t pkts_ready);
+        Queue *queue;
+        double train_end;   // when the last packet of the train has been serialized
+        uint32_t train;     // packets planned for the current train, 1 unless train_length says more
+};
+
 class HostFlowComparator {
     public:
         bool operator() (Flow* a, Flow* b);
@@ -23,6 +42,7 @@ class SchedulingHost : public Host {
         virtual void send();
         std::priority_queue<Flow*, std::vector<Flow*>, HostFlowComparator> sending_flows;
         HostProcessingEvent* host_proc_event;
+        HostPacer pacer;
 };
 
 #define HOST_PROCESSING 10
@@ -31,6 +51,7 @@ class HostProcessingEvent : public Event {
         HostProcessingEvent(double time, SchedulingHost *host);
         ~HostProcessingEvent();
         void process_event();
+        uint32_t target_id();
         SchedulingHost *host;
 };
 
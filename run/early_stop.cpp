@@ -0,0 +1,162 @@
+//
+// early_stop.cpp
+//
+
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <math.h>
+
+#include "early_stop.h"
+#include "params.h"
+
+extern DCExpParams params;
+extern double get_current_time();
+
+// two sided 95% Student t quantile, Cornish-Fisher expansion around z
+static double t_quantile_95(uint32_t df) {
+    double z = 1.959964;
+    double z3 = z * z * z;
+    double z5 = z3 * z * z;
+    return z + (z3 + z) / (4.0 * df) + (5 * z5 + 16 * z3 + 3 * z) / (96.0 * df * df);
+}
+
+BatchSeries::BatchSeries() {
+    this->warmup = 0;
+    this->mean = 0;
+    this->half_width = INFINITY;
+}
+
+void BatchSeries::add_batch(double estimate) {
+    batches.push_back(estimate);
+}
+
+uint32_t BatchSeries::num_batches() {
+    return batches.size();
+}
+
+void BatchSeries::update() {
+    uint32_t k = batches.size();
+    if (k < 2) {
+        return;
+    }
+
+    // MSER over truncation points d <= k/2, walking the suffix sums backwards
+    double sum = 0, sq_sum = 0;
+    double best = INFINITY;
+    uint32_t best_d = 0;
+    for (uint32_t d = k; d-- > 0;) {
+        sum += batches[d];
+        sq_sum += batches[d] * batches[d];
+        uint32_t n = k - d;
+        if (d > k / 2 || n < 2) {
+            continue;
+        }
+        double m = sum / n;
+        double stat = std::max(0.0, sq_sum / n - m * m) / n;
+        if (stat <= best) {
+            best = stat;
+            best_d = d;
+        }
+    }
+
+    uint32_t n = k - best_d;
+    double m = 0;
+    for (uint32_t i = best_d; i < k; i++) {
+        m += batches[i];
+    }
+    m /= n;
+    double var = 0;
+    for (uint32_t i = best_d; i < k; i++) {
+        var += (batches[i] - m) * (batches[i] - m);
+    }
+    var /= n - 1;
+
+    this->warmup = best_d;
+    this->mean = m;
+    this->half_width = t_quantile_95(n - 1) * sqrt(var / n);
+}
+
+BucketConvergence::BucketConvergence() {
+    this->num_flows = 0;
+}
+
+bool BucketConvergence::add(double slowdown) {
+    num_flows++;
+    batch.push_back(slowdown);
+    if (batch.size() < params.stop_batch_size) {
+        return false;
+    }
+
+    double sum = 0;
+    for (uint32_t i = 0; i < batch.size(); i++) {
+        sum += batch[i];
+    }
+    uint32_t loc = (uint32_t) (EARLY_STOP_TAIL * batch.size());
+    std::nth_element(batch.begin(), batch.begin() + loc, batch.end());
+    mean.add_batch(sum / batch.size());
+    tail.add_batch(batch[loc]);
+    batch.clear();
+
+    mean.update();
+    tail.update();
+    return true;
+}
+
+bool BucketConvergence::converged() {
+    if (mean.num_batches() - mean.warmup < params.stop_min_batches
+            || tail.num_batches() - tail.warmup < params.stop_min_batches) {
+        return false;
+    }
+    return mean.half_width / mean.mean < params.stop_ci_width
+        && tail.half_width / tail.mean < params.stop_ci_width;
+}
+
+EarlyStop::EarlyStop() {
+    this->stopped = false;
+    this->stopped_after = 0;
+    this->stopped_at = 0;
+    this->num_flows = 0;
+}
+
+// Buckets no flow has fallen into yet do not hold the run back; a bucket
+// with flows but too few batches does.
+bool EarlyStop::add(uint32_t size, double slowdown) {
+    num_flows++;
+    if (stopped || !buckets[size_bucket(size)].add(slowdown)) {
+        return false;
+    }
+    for (uint32_t b = 0; b < NUM_SIZE_BUCKETS - 1; b++) {
+        if (buckets[b].num_flows > 0 && !buckets[b].converged()) {
+            return false;
+        }
+    }
+    stopped = true;
+    stopped_after = num_flows;
+    stopped_at = get_current_time();
+    return true;
+}
+
+void EarlyStop::print() {
+    const char *names[NUM_SIZE_BUCKETS - 1] = {"<10KB", "10KB-1MB", ">1MB"};
+    std::cout << std::setprecision(4) << std::fixed;
+    if (stopped) {
+        std::cout << "EarlyStop converged after " << stopped_after << " flows at "
+            << 1000000 * stopped_at << "\n";
+    }
+    else {
+        std::cout << "EarlyStop did not converge\n";
+    }
+    for (uint32_t b = 0; b < NUM_SIZE_BUCKETS - 1; b++) {
+        BucketConvergence &c = buckets[b];
+        if (c.num_flows == 0) {
+            continue;
+        }
+        std::cout << "EarlyStop " << names[b] << " Flows " << c.num_flows
+            << " Batches " << c.mean.num_batches() << " Warmup " << c.mean.warmup << "/" << c.tail.warmup
+            << " Slowdown mean " << c.mean.mean << " +- " << c.mean.half_width
+            << " p99 " << c.tail.mean << " +- " << c.tail.half_width
+            << "\n";
+    }
+    std::cout << std::setprecision(9) << std::fixed;
+}
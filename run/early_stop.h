@@ -0,0 +1,67 @@
+//
+// early_stop.h
+// stopping rule for long runs: once the batch means confidence intervals of
+// the mean and p99 slowdown of every flow size bucket are narrow enough, no
+// more flows are injected and the run drains the flows already started.
+//
+
+#ifndef EARLY_STOP_H
+#define EARLY_STOP_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "stats.h"
+
+#define EARLY_STOP_TAIL 0.99
+
+// One metric observed as a sequence of batch estimates. The warm-up is the
+// prefix MSER picks: the truncation that minimizes the standard error of the
+// remaining batches.
+class BatchSeries {
+public:
+    BatchSeries();
+    void add_batch(double estimate);
+    void update();      // recomputes the warm-up and the interval
+    uint32_t num_batches();
+
+    uint32_t warmup;    // batches discarded
+    double mean;
+    double half_width;  // of the 95% confidence interval
+
+private:
+    std::vector<double> batches;
+};
+
+// Batch means for one size bucket: the mean slowdown and the p99 slowdown
+// of each batch of flows.
+class BucketConvergence {
+public:
+    BucketConvergence();
+    bool add(double slowdown);  // true when a batch closes
+    bool converged();
+    uint64_t num_flows;
+
+    BatchSeries mean;
+    BatchSeries tail;
+
+private:
+    std::vector<double> batch;
+};
+
+class EarlyStop {
+public:
+    EarlyStop();
+    bool add(uint32_t size, double slowdown);   // true once every bucket converged
+    void print();
+
+    bool stopped;
+    uint64_t stopped_after;     // finished flows when arrivals were stopped
+    double stopped_at;
+
+private:
+    BucketConvergence buckets[NUM_SIZE_BUCKETS - 1];
+    uint64_t num_flows;
+};
+
+#endif
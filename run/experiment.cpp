@@ -7,6 +7,7 @@
 #include <cstdlib>
 #include <ctime>
 #include <map>
+#include <set>
 #include <iomanip>
 #include "assert.h"
 #include "math.h"
@@ -18,6 +19,7 @@
 #include "../coresim/topology.h"
 #include "../coresim/queue.h"
 #include "../coresim/random_variable.h"
+#include "../coresim/debug.h"
 
 #include "../ext/factory.h"
 #include "../ext/fountainflow.h"
@@ -25,6 +27,12 @@
 #include "../ext/fastpassTopology.h"
 
 #include "flow_generator.h"
+#include "flow_trace.h"
+#include "flow_results.h"
+#include "result_sink.h"
+#include "early_stop.h"
+#include "fingerprint.h"
+#include "packet_trace.h"
 #include "stats.h"
 #include "params.h"
 
@@ -43,6 +51,7 @@ extern void add_to_event_queue(Event*);
 extern void read_experiment_parameters(std::string conf_filename, uint32_t exp_type);
 extern void read_flows_to_schedule(std::string filename, uint32_t num_lines, Topology *topo);
 extern uint32_t duplicated_packets_received;
+extern uint32_t total_finished_flows;
 
 extern uint32_t num_outstanding_packets_at_50;
 extern uint32_t num_outstanding_packets_at_100;
@@ -51,6 +60,8 @@ extern uint32_t arrival_packets_at_100;
 
 extern double start_time;
 extern double get_current_time();
+extern bool run_limit_reached;
+extern double run_stopped_at;
 
 extern void run_scenario();
 
@@ -80,16 +91,218 @@ void debug_flow_stats(std::deque<Flow *> flows){
         std::cout << it->first << " " << it->second << "\n";
 }
 
+ExponentialRandomVariable *deadline_rv = NULL;
+
+void assign_flow_deadline(Flow *f)
+{
+    if (deadline_rv == NULL) {
+        deadline_rv = new ExponentialRandomVariable(params.avg_deadline);
+        deadline_rv->set_stream(0, RNG_DEADLINE);
+    }
+    double rv = deadline_rv->value();
+    f->deadline = f->start_time + std::max(topology->get_oracle_fct(f)/1000000.0 * 1.25, rv);
+    //std::cout << f->start_time << " " << f->deadline << " " << topology->get_oracle_fct(f)/1000000 << " " << rv << "\n";
+}
+
 void assign_flow_deadline(std::deque<Flow *> flows)
 {
-    ExponentialRandomVariable *nv_intarr = new ExponentialRandomVariable(params.avg_deadline);
     for(uint i = 0; i < flows.size(); i++)
     {
-        Flow* f = flows[i];
-        double rv = nv_intarr->value();
-        f->deadline = f->start_time + std::max(topology->get_oracle_fct(f)/1000000.0 * 1.25, rv);
-        //std::cout << f->start_time << " " << f->deadline << " " << topology->get_oracle_fct(f)/1000000 << " " << rv << "\n";
+        assign_flow_deadline(flows[i]);
+    }
+}
+
+/*
+ * In stream_flows mode, flows are only created when the previous arrival is
+ * processed, so the full flow set is never held before the simulation starts.
+ */
+FlowGenerator *flow_stream = NULL;
+
+Event *get_next_flow_arrival() {
+    Flow *f = flow_stream->next_flow();
+    if (f == NULL) {
+        return NULL;
+    }
+    if (params.deadline && !flow_stream->has_deadlines()) {
+        assign_flow_deadline(f);
+    }
+    flows_to_schedule.push_back(f);
+    return new FlowArrivalEvent(f->start_time, f);
+}
+
+/*
+ * With retire_flows, finished flows leave their results in flow_results.
+ * flows_to_schedule is compacted once retired flows make up half of it, and
+ * each compacted flow is freed as soon as no packet or event points at it.
+ */
+FlowResultStore flow_results;
+uint32_t retired_in_schedule = 0;
+
+void retire_flow(Flow *f, double oracle_fct) {
+    flow_results.add(f, oracle_fct);
+    f->retired = true;
+    retired_in_schedule++;
+    if (retired_in_schedule < std::max((size_t) 1024, flows_to_schedule.size() / 2)) {
+        return;
+    }
+
+    std::deque<Flow *> live;
+    for (uint32_t i = 0; i < flows_to_schedule.size(); i++) {
+        Flow *g = flows_to_schedule[i];
+        if (!g->retired) {
+            live.push_back(g);
+            continue;
+        }
+        g->detached = true;
+        if (g->refs == 0) {
+            delete g;
+        }
+    }
+    flows_to_schedule.swap(live);
+    retired_in_schedule = 0;
+}
+
+// flows whose hosts never keep pointers to them outside packets and flow events
+bool flow_type_can_retire(uint32_t flow_type) {
+    return flow_type == NORMAL_FLOW || flow_type == PFABRIC_FLOW
+        || flow_type == VANILLA_TCP_FLOW || flow_type == DCTCP_FLOW;
+}
+
+// GEN_ONLY writes a binary trace instead of text when flow_trace_output is set
+FlowTraceWriter *open_flow_trace_output() {
+    if (params.flow_trace_output == "none") {
+        return NULL;
+    }
+    uint32_t flags = FLOW_TRACE_SORTED;
+    if (params.deadline) {
+        flags |= FLOW_TRACE_HAS_DEADLINE;
+    }
+    return new FlowTraceWriter(params.flow_trace_output, flags);
+}
+
+// FCT and slowdown summary by flow size, printed when size_bucket_stats is set
+FlowSizeStats flow_size_stats;
+
+/*
+ * With stop_ci_width set, arrivals stop once early_stop sees every size
+ * bucket converge. Flows that have not arrived yet are dropped; the ones in
+ * flight finish as usual.
+ */
+EarlyStop early_stop;
+bool flow_arrivals_stopped = false;
+uint32_t flows_discarded = 0;   // dropped or never made by stop_flow_arrivals
+
+void stop_flow_arrivals() {
+    if (flow_arrivals_stopped) {
+        return;
+    }
+    flow_arrivals_stopped = true;
+    if (params.stream_flows && flow_stream != NULL) {
+        flows_discarded += flow_stream->flows_left();
+    }
+    std::set<Flow *> never_arrived;
+    for (uint32_t i = 0; i < flow_arrivals.size(); i++) {
+        FlowArrivalEvent *ev = (FlowArrivalEvent *) flow_arrivals[i];
+        never_arrived.insert(ev->flow);
+        delete ev;
+    }
+    flow_arrivals.clear();
+    if (never_arrived.empty()) {
+        return;
+    }
+    flows_discarded += never_arrived.size();
+
+    std::deque<Flow *> arrived;
+    for (uint32_t i = 0; i < flows_to_schedule.size(); i++) {
+        Flow *f = flows_to_schedule[i];
+        if (never_arrived.count(f) == 0) {
+            arrived.push_back(f);
+        }
+    }
+    flows_to_schedule.swap(arrived);
+    for (auto it = never_arrived.begin(); it != never_arrived.end(); it++) {
+        delete *it;
+    }
+}
+
+// flows counted in the size bucket summaries and by early_stop
+bool in_measurement_window(Flow *f) {
+    double since_start = f->start_time - start_time;
+    if (since_start < params.warmup_time) {
+        return false;
+    }
+    return params.measure_time == 0 || since_start < params.warmup_time + params.measure_time;
+}
+
+// after end_time or the wall clock budget: one summary instead of a line per flow
+void report_unfinished_flows() {
+    uint32_t in_flight[NUM_SIZE_BUCKETS - 1] = {0};
+    uint32_t not_started = flows_discarded;
+    uint64_t bytes_left = 0;
+    for (uint32_t i = 0; i < flows_to_schedule.size(); i++) {
+        Flow *f = flows_to_schedule[i];
+        if (f->finished) {
+            continue;
+        }
+        // the arrival that was already queued when the run stopped is skipped
+        if (!f->arrived) {
+            not_started++;
+            continue;
+        }
+        in_flight[size_bucket(f->size)]++;
+        bytes_left += f->size - std::min(f->size, f->received_bytes);
+    }
+    std::cout << "Stopped at " << 1000000 * run_stopped_at
+        << " Finished " << total_finished_flows
+        << " Unfinished <10KB:" << in_flight[0] << " 10KB-1MB:" << in_flight[1] << " >1MB:" << in_flight[2]
+        << " BytesLeft " << bytes_left
+        << " NotStarted " << not_started << "\n";
+}
+
+// per flow results go to result_output through a ResultSink when it is set
+ResultSink *result_sink = NULL;
+
+void open_result_sink() {
+    if (params.result_output == "none") {
+        return;
+    }
+    result_sink = new ResultSink(params.result_output, ResultSink::parse_format(params.result_format));
+}
+
+void close_result_sink() {
+    delete result_sink;
+    result_sink = NULL;
+}
+
+// determinism fingerprint of the event sequence and flow results
+Fingerprint *fingerprint = NULL;
+
+void open_fingerprint() {
+    if (params.fingerprint_output == "none") {
+        return;
+    }
+    fingerprint = new Fingerprint(params.fingerprint_output, params.fingerprint_interval,
+        params.fingerprint_trace_from, params.fingerprint_trace_to);
+}
+
+void close_fingerprint() {
+    delete fingerprint;
+    fingerprint = NULL;
+}
+
+// enqueue, dequeue, drop and ECN mark records of every queue
+PacketTrace *packet_trace = NULL;
+
+void open_packet_trace() {
+    if (params.packet_trace_output == "none") {
+        return;
     }
+    packet_trace = new PacketTrace(params.packet_trace_output, params.packet_trace_sample);
+}
+
+void close_packet_trace() {
+    delete packet_trace;
+    packet_trace = NULL;
 }
 
 void printQueueStatistics(Topology *topo) {
@@ -101,6 +314,16 @@ void printQueueStatistics(Topology *topo) {
         dropAt[i] = 0;
     }
 
+    // trains still under way when the run ended count up to its last event
+    for (uint i = 0; i < topo->hosts.size(); i++) {
+        topo->hosts[i]->queue->settle();
+    }
+    for (uint i = 0; i < topo->switches.size(); i++) {
+        for (uint j = 0; j < topo->switches[i]->queues.size(); j++) {
+            topo->switches[i]->queues[j]->settle();
+        }
+    }
+
     for (uint i = 0; i < topo->hosts.size(); i++) {
         int location = topo->hosts[i]->queue->location;
         dropAt[location] += topo->hosts[i]->queue->pkt_drop;
@@ -135,9 +358,11 @@ void printQueueStatistics(Topology *topo) {
     }
 
     double dead_bytes = totalSentFromHosts - totalSentToHosts;
-    double total_bytes = 0;
+    double total_bytes = flow_results.total_bytes();
     for (auto f = flows_to_schedule.begin(); f != flows_to_schedule.end(); f++) {
-        total_bytes += (*f)->size;
+        if (!(*f)->retired) {
+            total_bytes += (*f)->size;
+        }
     }
 
     double simulation_time = current_time - start_time;
@@ -159,6 +384,7 @@ void run_experiment(int argc, char **argv, uint32_t exp_type) {
 
     std::string conf_filename(argv[2]);
     read_experiment_parameters(conf_filename, exp_type);
+    init_trace();
     params.num_hosts = 144;
     params.num_agg_switches = 9;
     params.num_core_switches = 4;
@@ -178,56 +404,102 @@ void run_experiment(int argc, char **argv, uint32_t exp_type) {
     FlowGenerator *fg;
     if (params.use_flow_trace) {
         fg = new FlowReader(num_flows, topology, params.cdf_or_flow_trace);
-        fg->make_flows();
     }
     else if (params.interarrival_cdf != "none") {
         fg = new CustomCDFFlowGenerator(num_flows, topology, params.cdf_or_flow_trace, params.interarrival_cdf);
-        fg->make_flows();
     }
     else if (params.permutation_tm != 0) {
         fg = new PermutationTM(num_flows, topology, params.cdf_or_flow_trace);
-        fg->make_flows();
+    }
+    else if (params.aggregate_poisson) {
+        fg = new AggregatePoissonFlowGenerator(num_flows, topology, params.cdf_or_flow_trace);
     }
     else if (params.bytes_mode) {
         fg = new PoissonFlowBytesGenerator(num_flows, topology, params.cdf_or_flow_trace);
-        fg->make_flows();
     }
     else if (params.traffic_imbalance < 0.01) {
         fg = new PoissonFlowGenerator(num_flows, topology, params.cdf_or_flow_trace);
-        fg->make_flows();
     }
     else {
-        // TODO skew flow gen not yet implemented, need to move to FlowGenerator
-        assert(false);
-        //generate_flows_to_schedule_fd_with_skew(params.cdf_or_flow_trace, num_flows, topology);
+        // skewed host popularity
+        fg = new AggregatePoissonFlowGenerator(num_flows, topology, params.cdf_or_flow_trace);
     }
 
-    if (params.deadline) {
-        assign_flow_deadline(flows_to_schedule);
+    if (!fg->can_stream()) {
+        params.stream_flows = 0;
+    }
+    if (!flow_type_can_retire(params.flow_type) || exp_type == GEN_ONLY) {
+        params.retire_flows = 0;
     }
 
-    std::deque<Flow*> flows_sorted = flows_to_schedule;
+    if (params.stream_flows) {
+        fg->seed_flows();
+        flow_stream = fg;
+        if (exp_type == GEN_ONLY) {
+            FlowTraceWriter *trace_output = open_flow_trace_output();
+            Flow *f;
+            while ((f = fg->next_flow()) != NULL) {
+                if (trace_output != NULL) {
+                    if (params.deadline) {
+                        assign_flow_deadline(f);
+                    }
+                    trace_output->write(f);
+                }
+                else {
+                    std::cout << f->id << " " << f->size << " " << f->src->id << " " << f->dst->id << " " << 1e6*f->start_time << "\n";
+                }
+                delete f;
+            }
+            delete trace_output;
+            return;
+        }
+        Event *first_arrival = get_next_flow_arrival();
+        if (first_arrival != NULL) {
+            flow_arrivals.push_back(first_arrival);
+        }
+    }
+    else {
+        fg->make_flows();
+        topology->fill_oracle_fct_cache(flows_to_schedule);
 
-    struct FlowComparator {
-        bool operator() (Flow* a, Flow* b) {
-            return a->start_time < b->start_time;
+        if (params.deadline && !fg->has_deadlines()) {
+            assign_flow_deadline(flows_to_schedule);
         }
-    } fc;
 
-    std::sort (flows_sorted.begin(), flows_sorted.end(), fc);
+        std::deque<Flow*> flows_sorted = flows_to_schedule;
+
+        struct FlowComparator {
+            bool operator() (Flow* a, Flow* b) {
+                return a->start_time < b->start_time;
+            }
+        } fc;
 
-    for (uint32_t i = 0; i < flows_sorted.size(); i++) {
-        Flow* f = flows_sorted[i];
+        std::sort (flows_sorted.begin(), flows_sorted.end(), fc);
+
+        FlowTraceWriter *trace_output = NULL;
         if (exp_type == GEN_ONLY) {
-            std::cout << f->id << " " << f->size << " " << f->src->id << " " << f->dst->id << " " << 1e6*f->start_time << "\n";
+            trace_output = open_flow_trace_output();
         }
-        else {
-            flow_arrivals.push_back(new FlowArrivalEvent(f->start_time, f));
+
+        for (uint32_t i = 0; i < flows_sorted.size(); i++) {
+            Flow* f = flows_sorted[i];
+            if (exp_type == GEN_ONLY) {
+                if (trace_output != NULL) {
+                    trace_output->write(f);
+                }
+                else {
+                    std::cout << f->id << " " << f->size << " " << f->src->id << " " << f->dst->id << " " << 1e6*f->start_time << "\n";
+                }
+            }
+            else {
+                flow_arrivals.push_back(new FlowArrivalEvent(f->start_time, f));
+            }
         }
-    }
 
-    if (exp_type == GEN_ONLY) {
-        return;
+        if (exp_type == GEN_ONLY) {
+            delete trace_output;
+            return;
+        }
     }
 
     //add_to_event_queue(new LoggingEvent((flows_sorted.front())->start_time));
@@ -239,10 +511,19 @@ void run_experiment(int argc, char **argv, uint32_t exp_type) {
     // 
     // everything before this is setup; everything after is analysis
     //
+    open_result_sink();
+    open_fingerprint();
+    open_packet_trace();
     run_scenario();
+    close_packet_trace();
+    close_fingerprint();
+    close_result_sink();
 
-    for (uint32_t i = 0; i < flows_sorted.size(); i++) {
+    for (uint32_t i = 0; i < flows_to_schedule.size(); i++) {
         Flow *f = flows_to_schedule[i];
+        if (run_limit_reached && !f->finished) {
+            continue;
+        }
         validate_flow(f);
         if(!f->finished) {
             std::cout 
@@ -257,6 +538,16 @@ void run_experiment(int argc, char **argv, uint32_t exp_type) {
         }
     }
 
+    if (run_limit_reached) {
+        report_unfinished_flows();
+    }
+    if (params.size_bucket_stats) {
+        flow_size_stats.print();
+    }
+    if (params.stop_ci_width > 0) {
+        early_stop.print();
+    }
+
     //cleanup
     delete fg;
 }
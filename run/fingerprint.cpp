@@ -0,0 +1,68 @@
+//
+// fingerprint.cpp
+//
+
+#include <string.h>
+#include "assert.h"
+
+#include "fingerprint.h"
+
+#include "../coresim/event.h"
+#include "../coresim/flow.h"
+
+static uint64_t double_bits(double d) {
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    return bits;
+}
+
+Fingerprint::Fingerprint(std::string filename, uint64_t interval, uint64_t trace_from, uint64_t trace_to) {
+    file = fopen(filename.c_str(), "w");
+    assert(file != NULL);
+    this->interval = interval;
+    this->trace_from = trace_from;
+    this->trace_to = trace_to;
+    this->num_events = 0;
+    this->event_hash = 0;
+    this->num_flows = 0;
+    this->flow_hash = 0;
+    fprintf(file, "fingerprint %d interval %llu\n", FINGERPRINT_VERSION, (unsigned long long) interval);
+}
+
+Fingerprint::~Fingerprint() {
+    fprintf(file, "events %llu %016llx\n", (unsigned long long) num_events, (unsigned long long) event_hash);
+    fprintf(file, "flows %llu %016llx\n", (unsigned long long) num_flows, (unsigned long long) flow_hash);
+    fclose(file);
+}
+
+// splitmix64 finalizer over the running hash and the new value
+uint64_t Fingerprint::fold(uint64_t hash, uint64_t value) {
+    uint64_t z = hash ^ (value + 0x9E3779B97F4A7C15ULL + (hash << 6) + (hash >> 2));
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+void Fingerprint::add_event(Event *ev) {
+    uint32_t target = ev->target_id();
+    event_hash = fold(event_hash, double_bits(ev->time));
+    event_hash = fold(event_hash, ((uint64_t) ev->type << 32) | target);
+    num_events++;
+
+    if (num_events >= trace_from && num_events < trace_to) {
+        fprintf(file, "event %llu %.17g %u %u\n",
+            (unsigned long long) num_events, ev->time, ev->type, target);
+    }
+    if (interval > 0 && num_events % interval == 0) {
+        fprintf(file, "checkpoint %llu %.17g %016llx\n",
+            (unsigned long long) num_events, ev->time, (unsigned long long) event_hash);
+    }
+}
+
+void Fingerprint::add_flow_result(Flow *f) {
+    flow_hash = fold(flow_hash, f->id);
+    flow_hash = fold(flow_hash, double_bits(f->finish_time));
+    flow_hash = fold(flow_hash, ((uint64_t) f->total_pkt_sent << 32) | f->received_count);
+    flow_hash = fold(flow_hash, ((uint64_t) (uint32_t) f->data_pkt_drop << 32) | (uint32_t) f->ack_pkt_drop);
+    num_flows++;
+}
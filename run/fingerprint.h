@@ -0,0 +1,44 @@
+//
+// fingerprint.h
+// determinism fingerprint of a run, for checking that an engine change
+// leaves results alone. Every processed event folds (time, type, target id)
+// into a rolling hash and every finished flow folds its results into a
+// second one. The file holds the two totals, the event hash every
+// fingerprint_interval events, and optionally every event in a window;
+// fpcompare reports where two fingerprint files first diverge.
+//
+
+#ifndef FINGERPRINT_H
+#define FINGERPRINT_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+#define FINGERPRINT_VERSION 1
+
+class Event;
+class Flow;
+
+class Fingerprint {
+public:
+    Fingerprint(std::string filename, uint64_t interval, uint64_t trace_from, uint64_t trace_to);
+    ~Fingerprint();     // writes the totals
+    void add_event(Event *ev);
+    void add_flow_result(Flow *f);
+
+    static uint64_t fold(uint64_t hash, uint64_t value);
+
+private:
+    FILE *file;
+    uint64_t interval;
+    uint64_t trace_from;
+    uint64_t trace_to;
+
+    uint64_t num_events;
+    uint64_t event_hash;
+    uint64_t num_flows;
+    uint64_t flow_hash;
+};
+
+#endif
@@ -0,0 +1,124 @@
+//
+// fingerprint_compare.cpp
+// compares two fingerprint files and reports where the runs first diverge.
+// Built with `make fpcompare`; exits 0 when the runs match.
+//
+// A differing checkpoint bounds the first diverging event to a range; rerun
+// both sides with fingerprint_trace_from/to set to that range and compare
+// again to get the event itself.
+//
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+struct FingerprintFile {
+    std::vector<std::string> events;        // "event" lines, without the keyword
+    std::vector<uint64_t> checkpoint_num;
+    std::vector<std::string> checkpoints;   // time and hash
+    std::string event_total;
+    std::string flow_total;
+};
+
+bool read_fingerprint(const char *filename, FingerprintFile &fp) {
+    std::ifstream input(filename);
+    if (!input.good()) {
+        std::cout << "cannot open " << filename << "\n";
+        return false;
+    }
+    std::string line;
+    while (std::getline(input, line)) {
+        std::istringstream lineStream(line);
+        std::string key, rest;
+        lineStream >> key;
+        std::getline(lineStream, rest);
+        if (key == "event") {
+            fp.events.push_back(rest);
+        }
+        else if (key == "checkpoint") {
+            std::istringstream cp(rest);
+            uint64_t num;
+            cp >> num;
+            std::string state;
+            std::getline(cp, state);
+            fp.checkpoint_num.push_back(num);
+            fp.checkpoints.push_back(state);
+        }
+        else if (key == "events") {
+            fp.event_total = rest;
+        }
+        else if (key == "flows") {
+            fp.flow_total = rest;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        std::cout << "Usage: fpcompare <fingerprint a> <fingerprint b>\n";
+        return 2;
+    }
+    FingerprintFile a, b;
+    if (!read_fingerprint(argv[1], a) || !read_fingerprint(argv[2], b)) {
+        return 2;
+    }
+
+    // traced events name the diverging event exactly
+    for (uint32_t i = 0; i < a.events.size() || i < b.events.size(); i++) {
+        if (i < a.events.size() && i < b.events.size() && a.events[i] == b.events[i]) {
+            continue;
+        }
+        if (i >= a.events.size() || i >= b.events.size()) {
+            if (i == 0) {
+                break;  // only one side traced, nothing to compare
+            }
+            std::cout << "event trace of " << (i >= a.events.size() ? "a" : "b") << " ends after "
+                << i << " events\n";
+            return 1;
+        }
+        std::cout << "first diverging event (number time type target):\n"
+            << "  a:" << a.events[i] << "\n"
+            << "  b:" << b.events[i] << "\n";
+        return 1;
+    }
+
+    uint64_t last_match = 0;
+    for (uint32_t i = 0; i < a.checkpoints.size() && i < b.checkpoints.size(); i++) {
+        if (a.checkpoint_num[i] != b.checkpoint_num[i]) {
+            std::cout << "checkpoint intervals differ\n";
+            return 1;
+        }
+        if (a.checkpoints[i] != b.checkpoints[i]) {
+            std::cout << "runs diverge between event " << last_match + 1 << " and " << a.checkpoint_num[i] << "\n"
+                << "  a:" << a.checkpoints[i] << "\n"
+                << "  b:" << b.checkpoints[i] << "\n"
+                << "rerun both with fingerprint_trace_from: " << last_match + 1
+                << " and fingerprint_trace_to: " << a.checkpoint_num[i] + 1 << "\n";
+            return 1;
+        }
+        last_match = a.checkpoint_num[i];
+    }
+
+    bool same = true;
+    if (a.event_total != b.event_total) {
+        std::cout << "events differ after event " << last_match << " (count hash)\n"
+            << "  a:" << a.event_total << "\n"
+            << "  b:" << b.event_total << "\n";
+        same = false;
+    }
+    if (a.flow_total != b.flow_total) {
+        std::cout << "flow results differ (count hash)\n"
+            << "  a:" << a.flow_total << "\n"
+            << "  b:" << b.flow_total << "\n";
+        same = false;
+    }
+    if (same) {
+        std::cout << "identical: events" << a.event_total << ", flows" << a.flow_total << "\n";
+        return 0;
+    }
+    return 1;
+}
@@ -5,12 +5,44 @@
 // 6/15/2015 Akshay Narayan
 //
 
+#include <functional>
+#include <limits>
+#include <thread>
+
 #include "flow_generator.h"
 
+// draws per merge round the horizon step grows towards
+#define PARTITION_ROUND_FLOWS 65536
+
+void FlowPartition::add_chain(FlowCreationForInitializationEvent *ev) {
+    Chain c = {ev->time, ev->src, ev->dst, ev->nv_bytes, ev->nv_intarr};
+    chains.push(c);
+    delete ev;
+}
+
+// Draws every flow that starts before horizon, in start time order.
+void FlowPartition::generate_until(double horizon) {
+    while (chains.size() > 0 && chains.top().time < horizon) {
+        Chain c = chains.top();
+        chains.pop();
+        FlowDraw d = {c.time, c.src, c.dst, c.nv_bytes->value()};
+        draws.push_back(d);
+        c.time += c.nv_intarr->value();
+        chains.push(c);
+    }
+}
+
+double FlowPartition::next_time() {
+    return chains.size() > 0 ? chains.top().time : std::numeric_limits<double>::max();
+}
+
 FlowGenerator::FlowGenerator(uint32_t num_flows, Topology *topo, std::string filename) {
     this->num_flows = num_flows;
     this->topo = topo;
     this->filename = filename;
+    this->flows_made = 0;
+    this->horizon = -1;
+    this->horizon_step = 1e-4;
 }
 
 void FlowGenerator::write_flows_to_file(std::deque<Flow *> flows, std::string file){
@@ -30,27 +62,160 @@ void FlowGenerator::write_flows_to_file(std::deque<Flow *> flows, std::string fi
     output.close();
 }
 
-//sample flow generation. Should be overridden.
 void FlowGenerator::make_flows() {
+    seed_flows();
+    Flow *f;
+    while ((f = next_flow()) != NULL) {
+        flows_to_schedule.push_back(f);
+    }
+}
+
+//sample flow generation. Should be overridden.
+void FlowGenerator::seed_flows() {
     EmpiricalRandomVariable *nv_bytes = new EmpiricalRandomVariable(filename);
     ExponentialRandomVariable *nv_intarr = new ExponentialRandomVariable(0.0000001);
-    add_to_event_queue(new FlowCreationForInitializationEvent(1.0, topo->hosts[0], topo->hosts[1], nv_bytes, nv_intarr));
+    add_creation_event(new FlowCreationForInitializationEvent(1.0, topo->hosts[0], topo->hosts[1], nv_bytes, nv_intarr));
+}
 
-    while (event_queue.size() > 0) {
-        Event *ev = event_queue.top();
-        event_queue.pop();
-        current_time = ev->time;
-        if (flows_to_schedule.size() < 10) {
-            ev->process_event();
+bool FlowGenerator::can_stream() {
+    return true;
+}
+
+// true if the flows come with deadlines, which assign_flow_deadline must keep
+bool FlowGenerator::has_deadlines() {
+    return false;
+}
+
+// flows next_flow() has yet to make
+uint32_t FlowGenerator::flows_left() {
+    return num_flows - flows_made;
+}
+
+void FlowGenerator::add_creation_event(FlowCreationForInitializationEvent *ev) {
+    creation_events.push(ev);
+}
+
+void FlowGenerator::add_creation_event(FlowCreationForInitializationEvent *ev, uint32_t partition) {
+    while (partitions.size() <= partition) {
+        partitions.push_back(new FlowPartition());
+    }
+    partitions[partition]->add_chain(ev);
+}
+
+void FlowGenerator::clear_creation_events() {
+    while (creation_events.size() > 0) {
+        delete creation_events.top();
+        creation_events.pop();
+    }
+    for (uint32_t i = 0; i < partitions.size(); i++) {
+        delete partitions[i];
+    }
+    partitions.clear();
+    merged_draws.clear();
+}
+
+/*
+ * Moves the horizon forward and has every partition draw up to it, spread
+ * over gen_threads threads (0 and 1 both draw on this thread). The draws
+ * before the horizon are final, so they are merged by start time (ties go to
+ * the lower partition) and queued.
+ */
+void FlowGenerator::extend_horizon() {
+    if (horizon < 0) {
+        horizon = std::numeric_limits<double>::max();
+        for (uint32_t i = 0; i < partitions.size(); i++) {
+            horizon = std::min(horizon, partitions[i]->next_time());
+        }
+    }
+    horizon += horizon_step;
+
+    uint32_t num_threads = std::max((uint32_t) 1, std::min(params.gen_threads, (uint32_t) partitions.size()));
+    std::vector<std::thread> workers;
+    for (uint32_t t = 1; t < num_threads; t++) {
+        workers.push_back(std::thread([this, t, num_threads] {
+            for (uint32_t p = t; p < partitions.size(); p += num_threads) {
+                partitions[p]->generate_until(horizon);
+            }
+        }));
+    }
+    for (uint32_t p = 0; p < partitions.size(); p += num_threads) {
+        partitions[p]->generate_until(horizon);
+    }
+    for (uint32_t t = 0; t < workers.size(); t++) {
+        workers[t].join();
+    }
+
+    typedef std::pair<double, uint32_t> Head;
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head> > heads;
+    for (uint32_t p = 0; p < partitions.size(); p++) {
+        if (partitions[p]->draws.size() > 0) {
+            heads.push(Head(partitions[p]->draws.front().time, p));
+        }
+    }
+    uint32_t round_flows = 0;
+    while (heads.size() > 0) {
+        uint32_t p = heads.top().second;
+        heads.pop();
+        merged_draws.push_back(partitions[p]->draws.front());
+        partitions[p]->draws.pop_front();
+        round_flows++;
+        if (partitions[p]->draws.size() > 0) {
+            heads.push(Head(partitions[p]->draws.front().time, p));
+        }
+    }
+
+    if (round_flows < PARTITION_ROUND_FLOWS / 2) {
+        horizon_step *= 2;
+    }
+    else if (round_flows > PARTITION_ROUND_FLOWS * 2) {
+        horizon_step /= 2;
+    }
+}
+
+Flow *FlowGenerator::next_partitioned_flow() {
+    while (flows_made < num_flows) {
+        if (merged_draws.size() == 0) {
+            extend_horizon();
+            continue;
+        }
+        FlowDraw d = merged_draws.front();
+        merged_draws.pop_front();
+        Flow *f = FlowCreationForInitializationEvent::create_flow(flows_made, d.time, d.src, d.dst, d.size_draw);
+        if (f != NULL) {
+            flows_made++;
+            return f;
         }
+    }
+    clear_creation_events();
+    return NULL;
+}
+
+/*
+ * Returns the next flow in start time order, or NULL once num_flows flows
+ * have been made. Each call only advances the creation chain that is due.
+ */
+Flow *FlowGenerator::next_flow() {
+    if (partitions.size() > 0) {
+        return next_partitioned_flow();
+    }
+    while (flows_made < num_flows && creation_events.size() > 0) {
+        FlowCreationForInitializationEvent *ev = (FlowCreationForInitializationEvent *) creation_events.top();
+        creation_events.pop();
+        Flow *f = ev->create_flow(flows_made);
+        creation_events.push(ev->next_event());
         delete ev;
+        if (f != NULL) {
+            flows_made++;
+            return f;
+        }
     }
-    current_time = 0;
+    clear_creation_events();
+    return NULL;
 }
 
 PoissonFlowGenerator::PoissonFlowGenerator(uint32_t num_flows, Topology *topo, std::string filename) : FlowGenerator(num_flows, topo, filename) {};
     
-void PoissonFlowGenerator::make_flows() {
+void PoissonFlowGenerator::seed_flows() {
 	assert(false);
     EmpiricalRandomVariable *nv_bytes;
     if (params.smooth_cdf)
@@ -73,37 +238,31 @@ void PoissonFlowGenerator::make_flows() {
 
     //* [expr ($link_rate*$load*1000000000)/($meanFlowSize*8.0/1460*1500)]
     for (uint32_t i = 0; i < topo->hosts.size(); i++) {
+        EmpiricalRandomVariable *host_bytes = nv_bytes->clone();
+        host_bytes->set_stream(i, RNG_FLOW_SIZE);
+        ExponentialRandomVariable *host_intarr = new ExponentialRandomVariable(nv_intarr->avg_);
+        host_intarr->set_stream(i, RNG_INTERARRIVAL);
         for (uint32_t j = 0; j < topo->hosts.size(); j++) {
             if (i != j) {
-                double first_flow_time = 1.0 + nv_intarr->value();
-                add_to_event_queue(
+                double first_flow_time = 1.0 + host_intarr->value();
+                add_creation_event(
                     new FlowCreationForInitializationEvent(
                         first_flow_time,
                         topo->hosts[i], 
                         topo->hosts[j],
-                        nv_bytes, 
-                        nv_intarr
-                    )
+                        host_bytes, 
+                        host_intarr
+                    ),
+                    i
                 );
             }
         }
     }
-
-    while (event_queue.size() > 0) {
-        Event *ev = event_queue.top();
-        event_queue.pop();
-        current_time = ev->time;
-        if (flows_to_schedule.size() < num_flows) {
-            ev->process_event();
-        }
-        delete ev;
-    }
-    current_time = 0;
 }
 
 PoissonFlowBytesGenerator::PoissonFlowBytesGenerator(uint32_t num_flows, Topology *topo, std::string filename) : FlowGenerator(num_flows, topo, filename) {};
     
-void PoissonFlowBytesGenerator::make_flows() {
+void PoissonFlowBytesGenerator::seed_flows() {
     EmpiricalBytesRandomVariable *nv_bytes;
     nv_bytes = new EmpiricalBytesRandomVariable(filename);
 
@@ -116,37 +275,145 @@ void PoissonFlowBytesGenerator::make_flows() {
 
     //* [expr ($link_rate*$load*1000000000)/($meanFlowSize*8.0/1460*1500)]
     for (uint32_t i = 0; i < topo->hosts.size(); i++) {
+        EmpiricalRandomVariable *host_bytes = nv_bytes->clone();
+        host_bytes->set_stream(i, RNG_FLOW_SIZE);
+        ExponentialRandomVariable *host_intarr = new ExponentialRandomVariable(nv_intarr->avg_);
+        host_intarr->set_stream(i, RNG_INTERARRIVAL);
         for (uint32_t j = 0; j < topo->hosts.size(); j++) {
             if (i != j) {
-                double first_flow_time = 1.0 + nv_intarr->value();
-                add_to_event_queue(
+                double first_flow_time = 1.0 + host_intarr->value();
+                add_creation_event(
                     new FlowCreationForInitializationEvent(
                         first_flow_time,
                         topo->hosts[i], 
                         topo->hosts[j],
-                        nv_bytes, 
-                        nv_intarr
-                    )
+                        host_bytes, 
+                        host_intarr
+                    ),
+                    i
                 );
             }
         }
     }
+}
 
-    while (event_queue.size() > 0) {
-        Event *ev = event_queue.top();
-        event_queue.pop();
-        current_time = ev->time;
-        if (flows_to_schedule.size() < num_flows) {
-            ev->process_event();
+AggregatePoissonFlowGenerator::AggregatePoissonFlowGenerator(uint32_t num_flows, Topology *topo, std::string filename) : FlowGenerator(num_flows, topo, filename) {
+    this->nv_bytes = NULL;
+    this->nv_intarr = NULL;
+    this->src_sampler = NULL;
+    this->dst_sampler = NULL;
+    this->next_arrival_time = 1.0;
+}
+
+void AggregatePoissonFlowGenerator::seed_flows() {
+    double lambda;
+    if (params.bytes_mode) {
+        EmpiricalBytesRandomVariable *nv_bytes_with_hdr = new EmpiricalBytesRandomVariable(filename);
+        lambda = params.bandwidth * params.load / (nv_bytes_with_hdr->sizeWithHeader * 8.0);
+        nv_bytes = nv_bytes_with_hdr;
+    }
+    else {
+        if (params.smooth_cdf)
+            nv_bytes = new EmpiricalRandomVariable(filename);
+        else
+            nv_bytes = new CDFRandomVariable(filename);
+        lambda = params.bandwidth * params.load / (nv_bytes->mean_flow_size * 8.0 / 1460 * 1500);
+    }
+    params.mean_flow_size = nv_bytes->mean_flow_size;
+
+    // host popularity, as in the old skewed generator: each host appears
+    // round(N(10, traffic_imbalance)) times as a source and as a destination
+    uint32_t num_hosts = topo->hosts.size();
+    std::vector<double> src_weights(num_hosts, 1.0);
+    std::vector<double> dst_weights(num_hosts, 1.0);
+    if (params.traffic_imbalance >= 0.01) {
+        GaussianRandomVariable popularity(10, params.traffic_imbalance);
+        for (uint32_t i = 0; i < num_hosts; i++) {
+            src_weights[i] = std::max(0.0, round(popularity.value()));
+            dst_weights[i] = std::max(0.0, round(popularity.value()));
         }
-        delete ev;
     }
-    current_time = 0;
+    // next_flow redraws the destination until it differs from the source,
+    // which ends only if some other host can be drawn for every source
+    uint32_t num_dsts = 0;
+    for (uint32_t i = 0; i < num_hosts; i++) {
+        if (dst_weights[i] > 0) {
+            num_dsts++;
+        }
+    }
+    assert(num_dsts >= 2);
+    src_sampler = new AliasRandomVariable(src_weights);
+    dst_sampler = new AliasRandomVariable(dst_weights);
+    dst_sampler->set_stream(1, RNG_HOST_PICK);
+
+    // lambda is the per host arrival rate, so the network as a whole sees num_hosts times that
+    nv_intarr = new ExponentialRandomVariable(1.0 / (lambda * num_hosts));
+}
+
+Flow *AggregatePoissonFlowGenerator::next_flow() {
+    while (flows_made < num_flows) {
+        next_arrival_time += nv_intarr->value();
+        uint32_t s = src_sampler->sample();
+        uint32_t d = dst_sampler->sample();
+        while (d == s) {
+            d = dst_sampler->sample();
+        }
+        Flow *f = FlowCreationForInitializationEvent::create_flow(
+            flows_made,
+            next_arrival_time,
+            topo->hosts[s],
+            topo->hosts[d],
+            nv_bytes
+        );
+        if (f != NULL) {
+            flows_made++;
+            return f;
+        }
+    }
+    return NULL;
 }
 
-FlowReader::FlowReader(uint32_t num_flows, Topology *topo, std::string filename) : FlowGenerator(num_flows, topo, filename) {};
+FlowReader::FlowReader(uint32_t num_flows, Topology *topo, std::string filename) : FlowGenerator(num_flows, topo, filename) {
+    this->trace = NULL;
+    this->next_record = 0;
+    if (FlowTraceReader::is_binary_trace(filename)) {
+        this->trace = new FlowTraceReader(filename);
+    }
+}
 
 void FlowReader::make_flows() {
+    if (trace == NULL) {
+        read_text_trace();
+        return;
+    }
+    seed_flows();
+    Flow *f;
+    while ((f = next_flow()) != NULL) {
+        flows_to_schedule.push_back(f);
+    }
+}
+
+void FlowReader::seed_flows() {
+    assert(trace != NULL);
+    next_record = 0;
+    params.num_flows_to_run = trace->header->num_records;
+}
+
+Flow *FlowReader::next_flow() {
+    if (trace == NULL || next_record == trace->header->num_records) {
+        return NULL;
+    }
+    const FlowTraceRecord &r = trace->records[next_record++];
+    assert(r.src < topo->hosts.size() && r.dst < topo->hosts.size());
+    Flow *f = Factory::get_flow(r.id, r.start_time, r.size, topo->hosts[r.src], topo->hosts[r.dst], params.flow_type);
+    f->flow_priority = r.priority;
+    if (trace->header->flags & FLOW_TRACE_HAS_DEADLINE) {
+        f->deadline = r.deadline;
+    }
+    return f;
+}
+
+void FlowReader::read_text_trace() {
     std::ifstream input(filename);
     std::string line;
     while (std::getline(input, line)) {
@@ -173,6 +440,19 @@ void FlowReader::make_flows() {
     input.close();
 }
 
+// text traces are not necessarily sorted by start time
+bool FlowReader::can_stream() {
+    return trace != NULL && (trace->header->flags & FLOW_TRACE_SORTED);
+}
+
+bool FlowReader::has_deadlines() {
+    return trace != NULL && (trace->header->flags & FLOW_TRACE_HAS_DEADLINE);
+}
+
+uint32_t FlowReader::flows_left() {
+    return trace == NULL ? 0 : trace->header->num_records - next_record;
+}
+
 CustomCDFFlowGenerator::CustomCDFFlowGenerator(
         uint32_t num_flows, 
         Topology *topo, 
@@ -197,9 +477,11 @@ std::vector<EmpiricalRandomVariable*>* CustomCDFFlowGenerator::makeCDFArray(std:
             if (cdf_file.good()) {
                 if (fn_template.compare("%s/%d_%d_interarrivals.cdf") == 0) {
                     pairCDFs->at(params.num_host_types * i + j) = new EmpiricalRandomVariable(cdf_fn);
+                    pairCDFs->at(params.num_host_types * i + j)->set_stream(params.num_host_types * i + j, RNG_INTERARRIVAL);
                 }
                 else {
                     pairCDFs->at(params.num_host_types * i + j) = new CDFRandomVariable(cdf_fn);
+                    pairCDFs->at(params.num_host_types * i + j)->set_stream(params.num_host_types * i + j, RNG_FLOW_SIZE);
                 }
             }
             else {
@@ -254,7 +536,7 @@ uint32_t* customCdfFlowGenerator_getDestinations_rackscale(uint32_t num_hosts, u
     return dests;
 }
 
-uint32_t* customCdfFlowGenerator_getDestinations_dcscale(uint32_t num_hosts, uint32_t sender_id, uint32_t num_dests, uint32_t **dests_map) {
+uint32_t* customCdfFlowGenerator_getDestinations_dcscale(uint32_t num_hosts, uint32_t sender_id, uint32_t num_dests, uint32_t **dests_map, RandomStream &rng) {
     if (dests_map[sender_id] == NULL) {
         auto num_unfilled = 0;
         for (auto i = 0; i < num_hosts; i++) if (dests_map[i] == NULL) num_unfilled++;
@@ -268,7 +550,7 @@ uint32_t* customCdfFlowGenerator_getDestinations_dcscale(uint32_t num_hosts, uin
         for (auto i = 1; i < num_dests; i++) {
             uint32_t ind;
             do {
-                ind = rand() % num_hosts;
+                ind = rng.below(num_hosts);
             } while(dests_map[ind] != NULL);
             cluster[i] = ind;
             dests_map[ind] = cluster;
@@ -278,12 +560,13 @@ uint32_t* customCdfFlowGenerator_getDestinations_dcscale(uint32_t num_hosts, uin
     return dests_map[sender_id];
 }
 
-void CustomCDFFlowGenerator::make_flows() {
+void CustomCDFFlowGenerator::seed_flows() {
     std::vector<EmpiricalRandomVariable*>* sizeMatrix = makeCDFArray("%s/%d_%d_sizes.cdf", filename);
     std::vector<EmpiricalRandomVariable*>* interarrivalMatrix = makeCDFArray("%s/%d_%d_interarrivals.cdf", filename);
     uint32_t num_hosts = topo->hosts.size();
 
     uint32_t** clusters;
+    RandomStream cluster_rng(0, RNG_TRAFFIC_MATRIX);
     if (params.ddc_type == 0) {
         clusters = new uint32_t*[num_hosts];
         for (auto i = 0; i < num_hosts; i++) {
@@ -305,7 +588,7 @@ void CustomCDFFlowGenerator::make_flows() {
             dests = customCdfFlowGenerator_getDestinations_rackscale(num_hosts, i, params.num_host_types - 1);
         }
         else {
-            dests = customCdfFlowGenerator_getDestinations_dcscale(num_hosts, i, params.num_host_types, clusters);
+            dests = customCdfFlowGenerator_getDestinations_dcscale(num_hosts, i, params.num_host_types, clusters, cluster_rng);
             
             if (dests == NULL) {
                 std::cout << i << " no flows\n";
@@ -356,14 +639,15 @@ void CustomCDFFlowGenerator::make_flows() {
             for (uint32_t k = 0; k < 3; k++) {
                 if (nv_bytes != NULL && nv_intarr != NULL) {
                     double first_flow_time = 1.0 + nv_intarr->value();
-                    add_to_event_queue(
+                    add_creation_event(
                         new FlowCreationForInitializationEvent(
                             first_flow_time,
                             topo->hosts[i], 
                             topo->hosts[d],
                             nv_bytes, 
                             nv_intarr
-                        )
+                        ),
+                        params.num_host_types * sender_profile + j
                     );
                 }
             }
@@ -382,22 +666,11 @@ void CustomCDFFlowGenerator::make_flows() {
 
     delete sizeMatrix;
     delete interarrivalMatrix;
-
-    while (event_queue.size() > 0) {
-        Event *ev = event_queue.top();
-        event_queue.pop();
-        current_time = ev->time;
-        if (flows_to_schedule.size() < num_flows) {
-            ev->process_event();
-        }
-        delete ev;
-    }
-    current_time = 0;
 }
 
 PermutationTM::PermutationTM(uint32_t num_flows, Topology *topo, std::string filename) : FlowGenerator(num_flows, topo, filename) {}
 
-void PermutationTM::make_flows() {
+void PermutationTM::seed_flows() {
     EmpiricalRandomVariable *nv_bytes;
     if (params.smooth_cdf)
         nv_bytes = new EmpiricalRandomVariable(filename);
@@ -412,35 +685,30 @@ void PermutationTM::make_flows() {
     auto *nv_intarr = new ExponentialRandomVariable(1.0 / lambda);
 
     std::set<uint32_t> dests;
+    RandomStream dest_rng(0, RNG_TRAFFIC_MATRIX);
     for (uint32_t i = 0; i < topo->hosts.size(); i++) {
         uint32_t j = i;
         while (j == i || dests.find(j) != dests.end()) { // orig. "j != i"
-            j = rand() % topo->hosts.size();
+            j = dest_rng.below(topo->hosts.size());
         }
         dests.insert(j);
-        double first_flow_time = 1.0 + nv_intarr->value();
+        EmpiricalRandomVariable *host_bytes = nv_bytes->clone();
+        host_bytes->set_stream(i, RNG_FLOW_SIZE);
+        ExponentialRandomVariable *host_intarr = new ExponentialRandomVariable(nv_intarr->avg_);
+        host_intarr->set_stream(i, RNG_INTERARRIVAL);
+        double first_flow_time = 1.0 + host_intarr->value();
         assert(i != j);
-        add_to_event_queue(
+        add_creation_event(
             new FlowCreationForInitializationEvent(
                 first_flow_time,
                 topo->hosts[i], 
                 topo->hosts[j],
-                nv_bytes, 
-                nv_intarr
-            )
+                host_bytes, 
+                host_intarr
+            ),
+            i
         );
     }
-
-    while (event_queue.size() > 0) {
-        Event *ev = event_queue.top();
-        event_queue.pop();
-        current_time = ev->time;
-        if (flows_to_schedule.size() < num_flows) {
-            ev->process_event();
-        }
-        delete ev;
-    }
-    current_time = 0;
 }
 
 //
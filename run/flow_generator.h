@@ -32,6 +32,7 @@
 #include "../ext/factory.h"
 
 #include "params.h"
+#include "flow_trace.h"
 
 extern Topology *topology;
 extern double current_time;
@@ -45,7 +46,53 @@ extern void add_to_event_queue(Event *);
 extern double start_time;
 extern double get_current_time();
 
+// A flow drawn by a FlowPartition, turned into a Flow once it is merged.
+struct FlowDraw {
+    double time;
+    Host *src;
+    Host *dst;
+    double size_draw;
+};
+
+// The creation chains of one source host (or host type pair) together with
+// random variables nothing else draws from, so a partition can run ahead on
+// its own thread and still produce the same draws.
+class FlowPartition {
+public:
+    void add_chain(FlowCreationForInitializationEvent *ev);
+    void generate_until(double horizon);
+    double next_time();
+
+    std::deque<FlowDraw> draws;
+
+private:
+    struct Chain {
+        double time;
+        Host *src;
+        Host *dst;
+        EmpiricalRandomVariable *nv_bytes;
+        RandomVariable *nv_intarr;
+    };
+    struct ChainComparator {
+        bool operator() (const Chain &a, const Chain &b) {
+            return a.time > b.time;
+        }
+    };
+    std::priority_queue<Chain, std::vector<Chain>, ChainComparator> chains;
+};
+
 // subclass FlowGenerator to implement your favorite flow generation scheme
+//
+// Generators seed one FlowCreationForInitializationEvent chain per source
+// of flows in seed_flows(). make_flows() then builds all flows up front into
+// flows_to_schedule, while next_flow() lets the simulation pull flows one at
+// a time in start time order (stream_flows mode).
+//
+// Generators that support it give every partition its own random variables
+// and seed its chains with add_creation_event(ev, p). next_flow() then has
+// the partitions draw ahead, on gen_threads threads, up to a common time
+// horizon and merges them by start time, so the flows do not depend on the
+// number of threads; gen_threads 0 is the same as 1.
 
 class FlowGenerator {
 public:
@@ -56,30 +103,80 @@ public:
     FlowGenerator(uint32_t num_flows, Topology *topo, std::string filename);
     virtual void write_flows_to_file(std::deque<Flow*> flows, std::string file);
     virtual void make_flows();
+    virtual void seed_flows();
+    virtual bool can_stream();
+    virtual bool has_deadlines();
+    virtual Flow *next_flow();
+    virtual uint32_t flows_left();
+
+protected:
+    void add_creation_event(FlowCreationForInitializationEvent *ev);
+    void add_creation_event(FlowCreationForInitializationEvent *ev, uint32_t partition);
+    void clear_creation_events();
+    Flow *next_partitioned_flow();
+    void extend_horizon();
+
+    std::priority_queue<Event *, std::vector<Event *>, EventComparator> creation_events;
+    uint32_t flows_made;
+
+    std::vector<FlowPartition *> partitions;
+    std::deque<FlowDraw> merged_draws;
+    double horizon;
+    double horizon_step;
 };
 
 class PoissonFlowGenerator : public FlowGenerator {
 public:
     PoissonFlowGenerator(uint32_t num_flows, Topology *topo, std::string filename);
-    virtual void make_flows();
+    virtual void seed_flows();
 };
 
 class PoissonFlowBytesGenerator : public FlowGenerator {
 public:
     PoissonFlowBytesGenerator(uint32_t num_flows, Topology *topo, std::string filename);
-    virtual void make_flows();
+    virtual void seed_flows();
+};
+
+// One network-wide Poisson arrival process instead of one chain per host
+// pair. Sources and destinations are drawn from alias tables, so each flow
+// costs O(1) and memory is O(hosts). traffic_imbalance skews the weights.
+class AggregatePoissonFlowGenerator : public FlowGenerator {
+public:
+    AggregatePoissonFlowGenerator(uint32_t num_flows, Topology *topo, std::string filename);
+    virtual void seed_flows();
+    virtual Flow *next_flow();
+
+private:
+    EmpiricalRandomVariable *nv_bytes;
+    ExponentialRandomVariable *nv_intarr;
+    AliasRandomVariable *src_sampler;
+    AliasRandomVariable *dst_sampler;
+    double next_arrival_time;
 };
 
+// Reads a binary trace (see flow_trace.h) through mmap, or else the text
+// format written by write_flows_to_file.
 class FlowReader : public FlowGenerator {
 public:
     FlowReader(uint32_t num_flows, Topology *topo, std::string filename);
     virtual void make_flows();
+    virtual void seed_flows();
+    virtual bool can_stream();
+    virtual bool has_deadlines();
+    virtual Flow *next_flow();
+    virtual uint32_t flows_left();
+
+private:
+    void read_text_trace();
+
+    FlowTraceReader *trace;
+    uint64_t next_record;
 };
 
 class CustomCDFFlowGenerator : public FlowGenerator {
 public:
     CustomCDFFlowGenerator(uint32_t num_flows, Topology *topo, std::string filename, std::string interarrivals_cdf_filename);
-    virtual void make_flows();
+    virtual void seed_flows();
 
     std::string interarrivals_cdf_filename;
 private:
@@ -89,7 +186,7 @@ private:
 class PermutationTM : public FlowGenerator {
 public:
     PermutationTM(uint32_t num_flows, Topology *topo, std::string filename);
-    virtual void make_flows();
+    virtual void seed_flows();
 
 };
 
@@ -0,0 +1,46 @@
+//
+// flow_results.cpp
+//
+
+#include "flow_results.h"
+
+#include "../coresim/flow.h"
+#include "../coresim/node.h"
+
+void FlowResultStore::add(Flow *f, double oracle_fct) {
+    this->id.push_back(f->id);
+    this->size.push_back(f->size);
+    this->src.push_back(f->src->id);
+    this->dst.push_back(f->dst->id);
+    this->start_time.push_back(f->start_time);
+    this->finish_time.push_back(f->finish_time);
+    this->oracle_fct.push_back(oracle_fct);
+    this->total_pkt_sent.push_back(f->total_pkt_sent);
+    this->data_pkt_drop.push_back(f->data_pkt_drop);
+    this->ack_pkt_drop.push_back(f->ack_pkt_drop);
+}
+
+uint32_t FlowResultStore::num_flows() {
+    return id.size();
+}
+
+uint64_t FlowResultStore::total_bytes() {
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < size.size(); i++) {
+        total += size[i];
+    }
+    return total;
+}
+
+void FlowResultStore::clear() {
+    id.clear();
+    size.clear();
+    src.clear();
+    dst.clear();
+    start_time.clear();
+    finish_time.clear();
+    oracle_fct.clear();
+    total_pkt_sent.clear();
+    data_pkt_drop.clear();
+    ack_pkt_drop.clear();
+}
@@ -0,0 +1,34 @@
+//
+// flow_results.h
+// per flow results kept after the Flow itself is freed (retire_flows).
+//
+
+#ifndef FLOW_RESULTS_H
+#define FLOW_RESULTS_H
+
+#include <stdint.h>
+#include <vector>
+
+class Flow;
+
+// One column per reported field; row i is the i-th retired flow.
+class FlowResultStore {
+public:
+    void add(Flow *f, double oracle_fct);
+    uint32_t num_flows();
+    uint64_t total_bytes();
+    void clear();
+
+    std::vector<uint32_t> id;
+    std::vector<uint32_t> size;
+    std::vector<uint32_t> src;
+    std::vector<uint32_t> dst;
+    std::vector<double> start_time;
+    std::vector<double> finish_time;
+    std::vector<double> oracle_fct;
+    std::vector<uint32_t> total_pkt_sent;
+    std::vector<uint32_t> data_pkt_drop;
+    std::vector<uint32_t> ack_pkt_drop;
+};
+
+#endif
@@ -0,0 +1,85 @@
+//
+// flow_trace.cpp
+// reading and writing binary flow traces.
+//
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "assert.h"
+
+#include "flow_trace.h"
+
+#include "../coresim/flow.h"
+#include "../coresim/node.h"
+
+// num_records is filled in when the writer is destroyed
+FlowTraceWriter::FlowTraceWriter(std::string filename, uint32_t flags) {
+    file = fopen(filename.c_str(), "wb");
+    assert(file != NULL);
+    setvbuf(file, NULL, _IOFBF, 1 << 20);
+    header.magic = FLOW_TRACE_MAGIC;
+    header.version = FLOW_TRACE_VERSION;
+    header.record_size = sizeof(FlowTraceRecord);
+    header.flags = flags;
+    header.num_records = 0;
+    fwrite(&header, sizeof(header), 1, file);
+}
+
+FlowTraceWriter::~FlowTraceWriter() {
+    fseek(file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, file);
+    fclose(file);
+}
+
+void FlowTraceWriter::write(Flow *f) {
+    FlowTraceRecord r;
+    r.id = f->id;
+    r.size = f->size;
+    r.src = f->src->id;
+    r.dst = f->dst->id;
+    r.start_time = f->start_time;
+    r.deadline = f->deadline;
+    r.priority = f->flow_priority;
+    r.reserved = 0;
+    size_t written = fwrite(&r, sizeof(r), 1, file);
+    assert(written == 1);
+    header.num_records++;
+}
+
+FlowTraceReader::FlowTraceReader(std::string filename) {
+    fd = open(filename.c_str(), O_RDONLY);
+    assert(fd >= 0);
+    struct stat st;
+    fstat(fd, &st);
+    map_size = st.st_size;
+    assert(map_size >= sizeof(FlowTraceHeader));
+
+    map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    assert(map != MAP_FAILED);
+    madvise(map, map_size, MADV_SEQUENTIAL);
+
+    header = (const FlowTraceHeader *) map;
+    assert(header->magic == FLOW_TRACE_MAGIC);
+    assert(header->version == FLOW_TRACE_VERSION);
+    assert(header->record_size == sizeof(FlowTraceRecord));
+    assert(sizeof(FlowTraceHeader) + header->num_records * sizeof(FlowTraceRecord) <= map_size);
+    records = (const FlowTraceRecord *) ((const char *) map + sizeof(FlowTraceHeader));
+}
+
+FlowTraceReader::~FlowTraceReader() {
+    munmap(map, map_size);
+    close(fd);
+}
+
+bool FlowTraceReader::is_binary_trace(std::string filename) {
+    FILE *f = fopen(filename.c_str(), "rb");
+    if (f == NULL) {
+        return false;
+    }
+    uint32_t magic = 0;
+    bool binary = fread(&magic, sizeof(magic), 1, f) == 1 && magic == FLOW_TRACE_MAGIC;
+    fclose(f);
+    return binary;
+}
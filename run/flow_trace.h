@@ -0,0 +1,69 @@
+//
+// flow_trace.h
+// binary flow trace: a fixed header followed by fixed width flow records.
+// GEN_ONLY writes it when flow_trace_output is set; FlowReader maps it with
+// mmap and walks the records in place. Text traces are still read as before.
+//
+
+#ifndef FLOW_TRACE_H
+#define FLOW_TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+#define FLOW_TRACE_MAGIC 0x52544C46 // "FLTR"
+#define FLOW_TRACE_VERSION 1
+
+// header flags
+#define FLOW_TRACE_SORTED 1         // records are in start time order
+#define FLOW_TRACE_HAS_DEADLINE 2   // deadline fields are meaningful
+
+struct FlowTraceHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t flags;
+    uint64_t num_records;
+};
+
+struct FlowTraceRecord {
+    uint32_t id;
+    uint32_t size;          // bytes
+    uint32_t src;
+    uint32_t dst;
+    double start_time;
+    double deadline;
+    uint32_t priority;
+    uint32_t reserved;
+};
+
+class Flow;
+
+class FlowTraceWriter {
+public:
+    FlowTraceWriter(std::string filename, uint32_t flags);
+    ~FlowTraceWriter();
+    void write(Flow *f);
+
+private:
+    FILE *file;
+    FlowTraceHeader header;
+};
+
+class FlowTraceReader {
+public:
+    FlowTraceReader(std::string filename);
+    ~FlowTraceReader();
+    static bool is_binary_trace(std::string filename);
+
+    const FlowTraceHeader *header;
+    const FlowTraceRecord *records;
+
+private:
+    int fd;
+    void *map;
+    size_t map_size;
+};
+
+#endif
@@ -0,0 +1,88 @@
+//
+// packet_trace.cpp
+//
+
+#include "assert.h"
+
+#include "packet_trace.h"
+#include "fingerprint.h"
+
+#include "../coresim/queue.h"
+#include "../coresim/packet.h"
+#include "../coresim/node.h"
+
+extern double get_current_time();
+
+PacketTrace::PacketTrace(std::string filename, double sample) {
+    assert(sample > 0 && sample <= 1);
+    file = fopen(filename.c_str(), "wb");
+    assert(file != NULL);
+    sample_per_million = (uint32_t) (sample * 1000000 + 0.5);
+
+    PacketTraceFileHeader header;
+    header.magic = PACKET_TRACE_MAGIC;
+    header.version = PACKET_TRACE_VERSION;
+    header.record_size = sizeof(PacketTraceRecord);
+    header.sample_per_million = sample_per_million;
+    fwrite(&header, sizeof(header), 1, file);
+}
+
+PacketTrace::~PacketTrace() {
+    for (uint32_t i = 0; i < buffers.size(); i++) {
+        if (!buffers[i].empty()) {
+            write_block(queues[i], buffers[i]);
+        }
+    }
+    fclose(file);
+}
+
+// the same flows at every hop and in every run
+bool PacketTrace::sampled(uint32_t flow_id) {
+    if (sample_per_million >= 1000000) {
+        return true;
+    }
+    return Fingerprint::fold(0, flow_id) % 1000000 < sample_per_million;
+}
+
+void PacketTrace::add(Queue *queue, Packet *packet, uint8_t event) {
+    uint32_t flow_id = packet->flow != NULL ? packet->flow->id : UINT32_MAX;
+    if (!sampled(flow_id)) {
+        return;
+    }
+    uint32_t q = queue->unique_id;
+    if (q >= buffers.size()) {
+        buffers.resize(q + 1);
+        queues.resize(q + 1, NULL);
+    }
+    if (queues[q] == NULL) {
+        queues[q] = queue;
+        buffers[q].reserve(PACKET_TRACE_BLOCK_RECORDS);
+    }
+
+    PacketTraceRecord r;
+    r.time = get_current_time();
+    r.packet_id = (uint32_t) packet->unique_id;
+    r.flow_id = flow_id;
+    r.seq_no = packet->seq_no;
+    r.bytes_in_queue = queue->bytes_in_queue;
+    r.src = packet->src->id;
+    r.dst = packet->dst->id;
+    r.size = packet->size;
+    r.event = event;
+    r.packet_type = packet->type;
+    buffers[q].push_back(r);
+    if (buffers[q].size() == PACKET_TRACE_BLOCK_RECORDS) {
+        write_block(queue, buffers[q]);
+    }
+}
+
+void PacketTrace::write_block(Queue *queue, std::vector<PacketTraceRecord> &buffer) {
+    PacketTraceBlockHeader header;
+    header.queue_id = queue->unique_id;
+    header.location = queue->location;
+    header.num_records = buffer.size();
+    header.reserved = 0;
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(&buffer[0], sizeof(PacketTraceRecord), buffer.size(), file);
+    buffer.clear();
+}
@@ -0,0 +1,79 @@
+//
+// packet_trace.h
+// binary per-hop packet trace: a fixed size record for every enqueue,
+// dequeue, drop and ECN mark at a queue, for the flows picked by
+// packet_trace_sample. Records collect in a buffer per queue; a full buffer
+// is written out as one block. pktrace reads the file back, see
+// packet_trace_tool.cpp.
+//
+
+#ifndef PACKET_TRACE_H
+#define PACKET_TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#define PACKET_TRACE_MAGIC 0x54504b50 // "PKPT"
+#define PACKET_TRACE_VERSION 1
+#define PACKET_TRACE_BLOCK_RECORDS 4096
+
+#define PACKET_TRACE_ENQUEUE 0  // taken into the queue; pFabric may push it out again
+#define PACKET_TRACE_DEQUEUE 1  // starts to leave
+#define PACKET_TRACE_DROP 2     // no room on arrival, or pushed out
+#define PACKET_TRACE_ECN 3      // marked as it was taken in
+
+// The file is a PacketTraceFileHeader, then blocks: a PacketTraceBlockHeader
+// followed by num_records records of one queue. Records of a queue are in
+// the order the simulator handled them; with packet_trains their times may
+// step back a little, as a train's packets are dequeued when it is settled.
+struct PacketTraceFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t sample_per_million;    // flows traced, per million
+};
+
+struct PacketTraceBlockHeader {
+    uint32_t queue_id;      // Queue::unique_id
+    int32_t location;       // 0 host, 1 ToR up, 2 core down, 3 ToR down
+    uint32_t num_records;
+    uint32_t reserved;
+};
+
+struct PacketTraceRecord {
+    double time;
+    uint32_t packet_id;     // low 32 bits of Packet::unique_id, the same at every hop
+    uint32_t flow_id;
+    uint32_t seq_no;
+    uint32_t bytes_in_queue;    // after the event
+    uint16_t src;           // host ids
+    uint16_t dst;
+    uint16_t size;
+    uint8_t event;
+    uint8_t packet_type;
+};
+
+class Queue;
+class Packet;
+
+class PacketTrace {
+public:
+    PacketTrace(std::string filename, double sample);
+    ~PacketTrace();     // writes the partly filled buffers
+    void add(Queue *queue, Packet *packet, uint8_t event);
+
+private:
+    bool sampled(uint32_t flow_id);
+    void write_block(Queue *queue, std::vector<PacketTraceRecord> &buffer);
+
+    FILE *file;
+    uint32_t sample_per_million;
+    std::vector<std::vector<PacketTraceRecord> > buffers;  // by queue unique_id
+    std::vector<Queue *> queues;
+};
+
+extern PacketTrace *packet_trace;
+
+#endif
@@ -0,0 +1,258 @@
+//
+// packet_trace_tool.cpp
+// reads a packet trace (packet_trace_output) back. Built with `make pktrace`.
+//
+//   pktrace delays <trace>                 queuing delay by hop
+//   pktrace drops <trace> [bin_us]         drops over time by hop
+//   pktrace pcap <trace> <queue> <file>    packets leaving one queue as pcap
+//
+// The pcap has raw IPv4 (linktype 101) and nanosecond timestamps. Each packet
+// is a made up 40 byte IPv4 and TCP header: hosts are 10.0.x.y, the two
+// ports hold the flow id, the sequence number is the packet's seq_no, and
+// the length the packet's size. Packets marked at this or an earlier traced hop
+// carry ECN CE.
+//
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "packet_trace.h"
+
+#define NUM_LOCATIONS 4
+
+const char *location_names[NUM_LOCATIONS] = {"host", "tor up", "core down", "tor down"};
+
+struct TraceEntry {
+    uint32_t queue_id;
+    int32_t location;
+    PacketTraceRecord r;
+};
+
+bool read_trace(const char *filename, std::vector<TraceEntry> &entries) {
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) {
+        std::cout << "cannot open " << filename << "\n";
+        return false;
+    }
+    PacketTraceFileHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != PACKET_TRACE_MAGIC
+            || header.version != PACKET_TRACE_VERSION || header.record_size != sizeof(PacketTraceRecord)) {
+        std::cout << filename << " is not a version " << PACKET_TRACE_VERSION << " packet trace\n";
+        fclose(file);
+        return false;
+    }
+    if (header.sample_per_million < 1000000) {
+        std::cout << "sampled: " << header.sample_per_million / 10000.0 << "% of flows\n";
+    }
+    PacketTraceBlockHeader block;
+    std::vector<PacketTraceRecord> records;
+    while (fread(&block, sizeof(block), 1, file) == 1) {
+        records.resize(block.num_records);
+        if (fread(&records[0], sizeof(PacketTraceRecord), block.num_records, file) != block.num_records) {
+            std::cout << filename << " is cut short\n";
+            break;
+        }
+        for (uint32_t i = 0; i < records.size(); i++) {
+            TraceEntry e;
+            e.queue_id = block.queue_id;
+            e.location = block.location;
+            e.r = records[i];
+            entries.push_back(e);
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+std::string location_name(int32_t location) {
+    if (location >= 0 && location < NUM_LOCATIONS) {
+        return location_names[location];
+    }
+    return "location " + std::to_string(location);
+}
+
+double percentile(std::vector<double> &sorted, double p) {
+    return sorted[(size_t) (p * (sorted.size() - 1))];
+}
+
+// time from enqueue to dequeue at each queue, by hop
+void print_delays(std::vector<TraceEntry> &entries) {
+    std::unordered_map<uint64_t, double> enqueued;  // queue, packet -> time
+    std::map<int32_t, std::vector<double> > delays;
+    for (uint32_t i = 0; i < entries.size(); i++) {
+        TraceEntry &e = entries[i];
+        uint64_t key = ((uint64_t) e.queue_id << 32) | e.r.packet_id;
+        if (e.r.event == PACKET_TRACE_ENQUEUE) {
+            enqueued[key] = e.r.time;
+        }
+        else if (e.r.event == PACKET_TRACE_DEQUEUE) {
+            auto it = enqueued.find(key);
+            if (it != enqueued.end()) {
+                delays[e.location].push_back(e.r.time - it->second);
+                enqueued.erase(it);
+            }
+        }
+        else if (e.r.event == PACKET_TRACE_DROP) {
+            enqueued.erase(key);
+        }
+    }
+
+    printf("%-10s %10s %10s %10s %10s %10s %10s\n", "hop", "packets", "mean us", "p50 us", "p90 us", "p99 us", "max us");
+    for (auto it = delays.begin(); it != delays.end(); it++) {
+        std::vector<double> &d = it->second;
+        std::sort(d.begin(), d.end());
+        double sum = 0;
+        for (uint32_t i = 0; i < d.size(); i++) {
+            sum += d[i];
+        }
+        printf("%-10s %10zu %10.3f %10.3f %10.3f %10.3f %10.3f\n", location_name(it->first).c_str(), d.size(),
+            sum / d.size() * 1e6, percentile(d, 0.5) * 1e6, percentile(d, 0.9) * 1e6,
+            percentile(d, 0.99) * 1e6, d.back() * 1e6);
+    }
+}
+
+// drops per bin_us microseconds, by hop; bins without drops are left out
+void print_drops(std::vector<TraceEntry> &entries, double bin_us) {
+    std::map<int64_t, std::map<int32_t, uint32_t> > bins;
+    std::map<int32_t, uint32_t> totals;
+    for (uint32_t i = 0; i < entries.size(); i++) {
+        TraceEntry &e = entries[i];
+        if (e.r.event != PACKET_TRACE_DROP) {
+            continue;
+        }
+        bins[(int64_t) (e.r.time * 1e6 / bin_us)][e.location]++;
+        totals[e.location]++;
+    }
+
+    printf("%-14s", "time us");
+    for (auto it = totals.begin(); it != totals.end(); it++) {
+        printf(" %10s", location_name(it->first).c_str());
+    }
+    printf("\n");
+    for (auto b = bins.begin(); b != bins.end(); b++) {
+        printf("%-14.1f", b->first * bin_us);
+        for (auto it = totals.begin(); it != totals.end(); it++) {
+            printf(" %10u", b->second.count(it->first) ? b->second[it->first] : 0);
+        }
+        printf("\n");
+    }
+    printf("%-14s", "total");
+    for (auto it = totals.begin(); it != totals.end(); it++) {
+        printf(" %10u", it->second);
+    }
+    printf("\n");
+}
+
+void put16(uint8_t *p, uint32_t v) {
+    p[0] = v >> 8;
+    p[1] = v;
+}
+
+void put32(uint8_t *p, uint32_t v) {
+    put16(p, v >> 16);
+    put16(p + 2, v);
+}
+
+bool write_pcap(std::vector<TraceEntry> &entries, uint32_t queue_id, const char *filename) {
+    std::unordered_map<uint32_t, double> marked;    // packet -> first mark
+    std::vector<PacketTraceRecord> sent;
+    for (uint32_t i = 0; i < entries.size(); i++) {
+        TraceEntry &e = entries[i];
+        if (e.r.event == PACKET_TRACE_ECN && marked.count(e.r.packet_id) == 0) {
+            marked[e.r.packet_id] = e.r.time;
+        }
+        if (e.r.event == PACKET_TRACE_DEQUEUE && e.queue_id == queue_id) {
+            sent.push_back(e.r);
+        }
+    }
+    // trains record departures out of order
+    std::stable_sort(sent.begin(), sent.end(),
+        [](const PacketTraceRecord &a, const PacketTraceRecord &b) { return a.time < b.time; });
+
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL) {
+        std::cout << "cannot open " << filename << "\n";
+        return false;
+    }
+    uint32_t global[6] = {0xa1b23c4d, 0x00040002, 0, 0, 65535, 101};
+    fwrite(global, sizeof(global), 1, file);
+    for (uint32_t i = 0; i < sent.size(); i++) {
+        PacketTraceRecord &r = sent[i];
+        uint8_t pkt[40] = {0};
+        auto m = marked.find(r.packet_id);
+        bool ce = m != marked.end() && m->second <= r.time;
+
+        pkt[0] = 0x45;
+        pkt[1] = ce ? 0x03 : 0x02;      // ECT(0) or CE
+        put16(pkt + 2, std::min<uint32_t>(r.size, 65535));
+        put16(pkt + 4, r.packet_id);
+        pkt[8] = 64;
+        pkt[9] = 6;
+        put32(pkt + 12, (10 << 24) | r.src);
+        put32(pkt + 16, (10 << 24) | r.dst);
+        uint32_t sum = 0;
+        for (uint32_t j = 0; j < 20; j += 2) {
+            sum += (pkt[j] << 8) | pkt[j + 1];
+        }
+        while (sum >> 16) {
+            sum = (sum & 0xffff) + (sum >> 16);
+        }
+        put16(pkt + 10, ~sum);
+
+        uint8_t *tcp = pkt + 20;
+        put16(tcp, r.flow_id);
+        put16(tcp + 2, r.flow_id >> 16);
+        if (r.packet_type == 1) {   // ACK_PACKET
+            put32(tcp + 8, r.seq_no);
+            tcp[13] = 0x10;
+        }
+        else {
+            put32(tcp + 4, r.seq_no);
+            tcp[13] = 0x18;
+        }
+        tcp[12] = 5 << 4;
+        put16(tcp + 14, 65535);
+
+        uint64_t ns = (uint64_t) (r.time * 1e9 + 0.5);
+        uint32_t record[4] = {(uint32_t) (ns / 1000000000), (uint32_t) (ns % 1000000000),
+            sizeof(pkt), r.size};
+        fwrite(record, sizeof(record), 1, file);
+        fwrite(pkt, sizeof(pkt), 1, file);
+    }
+    fclose(file);
+    std::cout << sent.size() << " packets from queue " << queue_id << " written to " << filename << "\n";
+    return true;
+}
+
+int main(int argc, char **argv) {
+    std::string command = argc > 1 ? argv[1] : "";
+    if (argc < 3 || (command != "delays" && command != "drops" && command != "pcap")
+            || (command == "pcap" && argc < 5)) {
+        std::cout << "Usage: pktrace delays <trace>\n"
+            << "       pktrace drops <trace> [bin_us]\n"
+            << "       pktrace pcap <trace> <queue id> <pcap file>\n";
+        return 2;
+    }
+    std::vector<TraceEntry> entries;
+    if (!read_trace(argv[2], entries)) {
+        return 2;
+    }
+
+    if (command == "delays") {
+        print_delays(entries);
+    }
+    else if (command == "drops") {
+        print_drops(entries, argc > 3 ? atof(argv[3]) : 100);
+    }
+    else if (!write_pcap(entries, atoi(argv[3]), argv[4])) {
+        return 2;
+    }
+    return 0;
+}
@@ -15,6 +15,38 @@ void read_experiment_parameters(std::string conf_filename, uint32_t exp_type) {
     params.interarrival_cdf = "none";
     params.permutation_tm = 0;
     params.hdr_size = 40;
+    params.stream_flows = 0;
+    params.aggregate_poisson = 0;
+    params.seed = 0;
+    params.gen_threads = 0;
+    params.flow_trace_output = "none";
+    params.retire_flows = 0;
+    params.result_output = "none";
+    params.result_format = "text";
+    params.size_bucket_stats = 0;
+    params.stop_ci_width = 0;
+    params.stop_batch_size = 1000;
+    params.stop_min_batches = 20;
+    params.end_time = 0;
+    params.drain_time = 0;
+    params.wall_clock_budget = 0;
+    params.warmup_time = 0;
+    params.measure_time = 0;
+    params.fingerprint_output = "none";
+    params.fingerprint_interval = 0;
+    params.fingerprint_trace_from = 0;
+    params.fingerprint_trace_to = 0;
+    params.packet_trace_output = "none";
+    params.packet_trace_sample = 1;
+    params.fastpass_pipeline_threads = 0;
+    params.host_pacer_train = 1;
+    params.packet_trains = 0;
+    params.delayed_ack_freq = 1;
+    params.delayed_ack_timeout = 10e-6;
+    params.trace_flows = "none";
+    params.trace_queues = "none";
+    params.trace_hosts = "none";
+    params.trace_start_time = 0;
     while (std::getline(input, line)) {
         std::istringstream lineStream(line);
         if (line.empty()) {
@@ -97,6 +129,86 @@ void read_experiment_parameters(std::string conf_filename, uint32_t exp_type) {
         else if (key == "use_flow_trace") {
             lineStream >> params.use_flow_trace;
         }
+        else if (key == "stream_flows") {
+            lineStream >> params.stream_flows;
+        }
+        else if (key == "aggregate_poisson") {
+            lineStream >> params.aggregate_poisson;
+        }
+        else if (key == "seed") {
+            lineStream >> params.seed;
+        }
+        else if (key == "gen_threads") {
+            lineStream >> params.gen_threads;
+        }
+        else if (key == "flow_trace_output") {
+            lineStream >> params.flow_trace_output;
+        }
+        else if (key == "retire_flows") {
+            lineStream >> params.retire_flows;
+        }
+        else if (key == "result_output") {
+            lineStream >> params.result_output;
+        }
+        else if (key == "result_format") {
+            lineStream >> params.result_format;
+        }
+        else if (key == "size_bucket_stats") {
+            lineStream >> params.size_bucket_stats;
+        }
+        else if (key == "stop_ci_width") {
+            lineStream >> params.stop_ci_width;
+        }
+        else if (key == "stop_batch_size") {
+            lineStream >> params.stop_batch_size;
+        }
+        else if (key == "stop_min_batches") {
+            lineStream >> params.stop_min_batches;
+        }
+        else if (key == "end_time") {
+            lineStream >> params.end_time;
+        }
+        else if (key == "drain_time") {
+            lineStream >> params.drain_time;
+        }
+        else if (key == "wall_clock_budget") {
+            lineStream >> params.wall_clock_budget;
+        }
+        else if (key == "warmup_time") {
+            lineStream >> params.warmup_time;
+        }
+        else if (key == "measure_time") {
+            lineStream >> params.measure_time;
+        }
+        else if (key == "fingerprint_output") {
+            lineStream >> params.fingerprint_output;
+        }
+        else if (key == "fingerprint_interval") {
+            lineStream >> params.fingerprint_interval;
+        }
+        else if (key == "fingerprint_trace_from") {
+            lineStream >> params.fingerprint_trace_from;
+        }
+        else if (key == "fingerprint_trace_to") {
+            lineStream >> params.fingerprint_trace_to;
+        }
+        else if (key == "packet_trace_output") {
+            lineStream >> params.packet_trace_output;
+        }
+        else if (key == "packet_trace_sample") {
+            lineStream >> params.packet_trace_sample;
+            assert(params.packet_trace_sample > 0 && params.packet_trace_sample <= 1);
+        }
+        else if (key == "fastpass_pipeline_threads") {
+            lineStream >> params.fastpass_pipeline_threads;
+        }
+        else if (key == "host_pacer_train") {
+            lineStream >> params.host_pacer_train;
+            assert(params.host_pacer_train >= 1);
+        }
+        else if (key == "packet_trains") {
+            lineStream >> params.packet_trains;
+        }
         else if (key == "smooth_cdf") {
             lineStream >> params.smooth_cdf;
         }
@@ -173,9 +285,26 @@ void read_experiment_parameters(std::string conf_filename, uint32_t exp_type) {
         else if (key == "bytes_mode") {
             lineStream >> params.bytes_mode;
         }
-        //else if (key == "dctcp_delayed_ack_freq") {
-        //    lineStream >> params.dctcp_delayed_ack_freq;
-        //}
+        else if (key == "delayed_ack_freq") {
+            lineStream >> params.delayed_ack_freq;
+            assert(params.delayed_ack_freq >= 1);
+        }
+        else if (key == "delayed_ack_timeout") {
+            lineStream >> params.delayed_ack_timeout;
+            assert(params.delayed_ack_timeout > 0);
+        }
+        else if (key == "trace_flows") {
+            lineStream >> params.trace_flows;
+        }
+        else if (key == "trace_queues") {
+            lineStream >> params.trace_queues;
+        }
+        else if (key == "trace_hosts") {
+            lineStream >> params.trace_hosts;
+        }
+        else if (key == "trace_start_time") {
+            lineStream >> params.trace_start_time;
+        }
         else {
             std::cout << "Unknown conf param: " << key << " in file: " << conf_filename << "\n";
             assert(false);
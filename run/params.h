@@ -22,7 +22,11 @@ class DCExpParams {
         double bandwidth;
 
         uint32_t num_flows_to_run;
-        double end_time;
+        double end_time;            // seconds after the first event; 0 runs to completion
+        double drain_time;          // after end_time or the wall clock budget
+        double wall_clock_budget;   // seconds of real time
+        double warmup_time;         // flows starting earlier are left out of summaries
+        double measure_time;        // and so are flows starting after warmup_time + measure_time
         std::string cdf_or_flow_trace;
         uint32_t bytes_mode;
         uint32_t cut_through;
@@ -45,6 +49,24 @@ class DCExpParams {
         uint32_t magic_inflate;
 
         uint32_t use_flow_trace;
+        uint32_t stream_flows;
+        uint32_t aggregate_poisson;
+        uint32_t seed;
+        uint32_t gen_threads;
+        std::string flow_trace_output;
+        uint32_t retire_flows;
+        std::string result_output;
+        std::string result_format;
+        uint32_t size_bucket_stats;
+        double stop_ci_width;
+        uint32_t stop_batch_size;
+        uint32_t stop_min_batches;
+        std::string fingerprint_output;
+        uint64_t fingerprint_interval;
+        uint64_t fingerprint_trace_from;
+        uint64_t fingerprint_trace_to;
+        std::string packet_trace_output; // binary per-hop packet trace, see packet_trace.h
+        double packet_trace_sample; // fraction of flows traced, picked by flow id hash
         uint32_t smooth_cdf;
         uint32_t burst_at_beginning;
         double capability_timeout;
@@ -70,11 +92,22 @@ class DCExpParams {
         uint32_t num_host_types;
 
         double fastpass_epoch_time;
+        uint32_t fastpass_pipeline_threads;
 
         uint32_t permutation_tm;
 
+        uint32_t host_pacer_train; // max packets a scheduling host sends per decision; above 1 also changes same-time event order
+        uint32_t packet_trains; // uncontended queues schedule departures ahead, see Queue::join_train
+
         uint32_t dctcp_mark_thresh;
-        //uint32_t dctcp_delayed_ack_freq;
+        uint32_t delayed_ack_freq; // data packets per ack for window based flows, see Flow::ack_data; 1 (default) acks every packet
+        double delayed_ack_timeout; // longest a receiver holds an ack back, 10 us by default
+
+        // ids traced by debug_flow/queue/host in a SIM_TRACE build, see debug.h
+        std::string trace_flows;
+        std::string trace_queues;
+        std::string trace_hosts;
+        double trace_start_time;
 
         double get_full_pkt_tran_delay(uint32_t size_in_byte = 1500)
         {
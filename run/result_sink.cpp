@@ -0,0 +1,162 @@
+//
+// result_sink.cpp
+//
+
+#include <chrono>
+#include <string.h>
+#include "assert.h"
+
+#include "result_sink.h"
+
+#include "../coresim/flow.h"
+#include "../coresim/node.h"
+
+ResultSink::ResultSink(std::string filename, uint32_t format) {
+    this->format = format;
+    file = fopen(filename.c_str(), "wb");
+    assert(file != NULL);
+    for (uint32_t i = 0; i < RESULT_NUM_BUFFERS; i++) {
+        buffers[i].data = new char[RESULT_BUFFER_SIZE];
+        buffers[i].len = 0;
+        if (i > 0) {
+            empty.push(&buffers[i]);
+        }
+    }
+    current = &buffers[0];
+    done = false;
+
+    if (format == RESULT_FORMAT_CSV) {
+        current->len += sprintf(current->data,
+            "id,size,src,dst,start_time_us,finish_time_us,fct_us,oracle_fct_us,slowdown,"
+            "pkts_sent,size_in_pkt,pkts_received,data_pkt_drop,ack_pkt_drop,pkt_drop,"
+            "first_byte_send_us\n");
+    }
+    else if (format == RESULT_FORMAT_BINARY) {
+        ResultFileHeader header;
+        header.magic = RESULT_FILE_MAGIC;
+        header.version = RESULT_FILE_VERSION;
+        header.num_columns = 10;
+        header.block_rows = RESULT_BLOCK_ROWS;
+        memcpy(current->data, &header, sizeof(header));
+        current->len += sizeof(header);
+    }
+
+    writer = std::thread([this] { writer_loop(); });
+}
+
+ResultSink::~ResultSink() {
+    if (format == RESULT_FORMAT_BINARY && block.num_flows() > 0) {
+        write_block();
+    }
+    if (current->len > 0) {
+        hand_off();
+    }
+    done = true;
+    writer.join();
+    fclose(file);
+    for (uint32_t i = 0; i < RESULT_NUM_BUFFERS; i++) {
+        delete[] buffers[i].data;
+    }
+}
+
+uint32_t ResultSink::parse_format(std::string name) {
+    if (name == "text") {
+        return RESULT_FORMAT_TEXT;
+    }
+    if (name == "csv") {
+        return RESULT_FORMAT_CSV;
+    }
+    if (name == "binary") {
+        return RESULT_FORMAT_BINARY;
+    }
+    assert(false);
+    return RESULT_FORMAT_TEXT;
+}
+
+void ResultSink::write(Flow *f, double oracle_fct, double slowdown) {
+    if (format == RESULT_FORMAT_BINARY) {
+        block.add(f, oracle_fct);
+        if (block.num_flows() == RESULT_BLOCK_ROWS) {
+            write_block();
+        }
+        return;
+    }
+
+    // text matches the stdout line, which prints doubles std::fixed with precision 4
+    const char *fmt = format == RESULT_FORMAT_CSV
+        ? "%u,%u,%u,%u,%.4f,%.4f,%.4f,%.4f,%.4f,%u,%u,%u,%d,%d,%d,%.4f\n"
+        : "%u %u %u %u %.4f %.4f %.4f %.4f %.4f %u/%u//%u %d/%d/%d %.4f \n";
+    reserve(RESULT_MAX_LINE);
+    current->len += snprintf(current->data + current->len, RESULT_MAX_LINE, fmt,
+        f->id, f->size, f->src->id, f->dst->id,
+        1000000 * f->start_time, 1000000 * f->finish_time,
+        1000000.0 * f->flow_completion_time, oracle_fct, slowdown,
+        f->total_pkt_sent, f->size / f->mss, f->received_count,
+        f->data_pkt_drop, f->ack_pkt_drop, f->pkt_drop,
+        1000000 * (f->first_byte_send_time - f->start_time));
+}
+
+// makes room for bytes more in the current buffer, handing it off if needed
+void ResultSink::reserve(uint32_t bytes) {
+    if (current->len + bytes > RESULT_BUFFER_SIZE) {
+        hand_off();
+    }
+}
+
+void ResultSink::hand_off() {
+    while (!filled.push(current)) {
+        std::this_thread::yield();
+    }
+    while (!empty.pop(current)) {
+        std::this_thread::yield();
+    }
+    current->len = 0;
+}
+
+template <typename T>
+static void append_column(ResultBuffer *b, std::vector<T> &column) {
+    uint32_t bytes = column.size() * sizeof(T);
+    memcpy(b->data + b->len, column.data(), bytes);
+    b->len += bytes;
+}
+
+void ResultSink::write_block() {
+    ResultBlockHeader header;
+    header.num_rows = block.num_flows();
+    header.reserved = 0;
+    reserve(sizeof(header) + header.num_rows * (7 * sizeof(uint32_t) + 3 * sizeof(double)));
+
+    memcpy(current->data + current->len, &header, sizeof(header));
+    current->len += sizeof(header);
+    append_column(current, block.id);
+    append_column(current, block.size);
+    append_column(current, block.src);
+    append_column(current, block.dst);
+    append_column(current, block.start_time);
+    append_column(current, block.finish_time);
+    append_column(current, block.oracle_fct);
+    append_column(current, block.total_pkt_sent);
+    append_column(current, block.data_pkt_drop);
+    append_column(current, block.ack_pkt_drop);
+    block.clear();
+}
+
+// runs on the writer thread; sleeps while there is nothing to write so it
+// does not take cycles from the event loop
+void ResultSink::writer_loop() {
+    while (true) {
+        bool finishing = done;
+        ResultBuffer *b;
+        if (filled.pop(b)) {
+            size_t written = fwrite(b->data, 1, b->len, file);
+            assert(written == b->len);
+            empty.push(b);
+        }
+        else if (finishing) {
+            return;
+        }
+        else {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+}
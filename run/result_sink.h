@@ -0,0 +1,80 @@
+//
+// result_sink.h
+// per flow result lines written to a file by a background thread.
+// The event loop formats each finished flow into a large buffer; full
+// buffers go to the writer thread over a single producer, single consumer
+// queue and come back empty over a second one.
+//
+
+#ifndef RESULT_SINK_H
+#define RESULT_SINK_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "flow_results.h"
+#include "../coresim/spsc_queue.h"
+
+#define RESULT_FORMAT_TEXT 0    // the same line as printed to stdout
+#define RESULT_FORMAT_CSV 1     // comma separated, with a header line
+#define RESULT_FORMAT_BINARY 2  // blocks of FlowResultStore columns
+
+#define RESULT_BUFFER_SIZE (1 << 20)
+#define RESULT_NUM_BUFFERS 8
+#define RESULT_MAX_LINE 512
+#define RESULT_BLOCK_ROWS 4096
+
+#define RESULT_FILE_MAGIC 0x53455246 // "FRES"
+#define RESULT_FILE_VERSION 1
+
+// Binary results: a ResultFileHeader, then blocks of up to block_rows rows.
+// Each block is a ResultBlockHeader followed by the FlowResultStore columns
+// in declaration order, num_rows values each. Times are in seconds.
+struct ResultFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_columns;
+    uint32_t block_rows;
+};
+
+struct ResultBlockHeader {
+    uint32_t num_rows;
+    uint32_t reserved;
+};
+
+struct ResultBuffer {
+    char *data;
+    uint32_t len;
+};
+
+class Flow;
+
+class ResultSink {
+public:
+    ResultSink(std::string filename, uint32_t format);
+    ~ResultSink();  // writes what is left, joins the writer, closes the file
+    void write(Flow *f, double oracle_fct, double slowdown);
+
+    static uint32_t parse_format(std::string name);
+
+private:
+    void reserve(uint32_t bytes);
+    void hand_off();
+    void write_block();
+    void writer_loop();
+
+    FILE *file;
+    uint32_t format;
+    ResultBuffer buffers[RESULT_NUM_BUFFERS];
+    ResultBuffer *current;
+    SpscQueue<ResultBuffer *, RESULT_NUM_BUFFERS> filled;
+    SpscQueue<ResultBuffer *, RESULT_NUM_BUFFERS> empty;
+    FlowResultStore block;  // binary rows not yet handed off
+    std::atomic<bool> done;
+    std::thread writer;
+};
+
+#endif
@@ -0,0 +1,87 @@
+//
+// rng_bench.cpp
+// times exponential interarrival sampling: one libm draw at a time against
+// the batched ExponentialRandomVariable paths, with the plain and the AVX2
+// kernels, and checks the two kernels agree. Built with `make rngbench`.
+//
+
+#include <algorithm>
+#include <iostream>
+#include <cstdlib>
+#include <ctime>
+#include <math.h>
+
+#include "../coresim/random_stream.h"
+#include "../coresim/random_variable.h"
+#include "params.h"
+
+DCExpParams params;
+
+double seconds_since(clock_t start) {
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char **argv) {
+    uint32_t n = argc > 1 ? atoi(argv[1]) : 100000000;
+    params.seed = 0;
+    double avg = 1e-6;
+    double sum;
+    clock_t start;
+
+    RandomStream scalar(0, RNG_INTERARRIVAL);
+    sum = 0;
+    start = clock();
+    for (uint32_t i = 0; i < n; i++) {
+        sum += -1.0 * avg * log(scalar.uniform());
+    }
+    std::cout << "scalar   " << seconds_since(start) << " s  mean " << sum / n << "\n";
+
+    bool has_avx2 = rng_avx2;
+    for (int avx2 = 0; avx2 <= (has_avx2 ? 1 : 0); avx2++) {
+        rng_avx2 = avx2;
+        const char *kernel = avx2 ? "avx2" : "plain";
+
+        ExponentialRandomVariable batched(avg);
+        batched.set_stream(0, RNG_INTERARRIVAL);
+        sum = 0;
+        start = clock();
+        for (uint32_t i = 0; i < n; i++) {
+            sum += batched.value();
+        }
+        std::cout << "value()  " << kernel << " " << seconds_since(start) << " s  mean " << sum / n << "\n";
+
+        ExponentialRandomVariable filled(avg);
+        filled.set_stream(0, RNG_INTERARRIVAL);
+        double buf[1024];
+        sum = 0;
+        start = clock();
+        for (uint32_t i = 0; i < n; i += 1024) {
+            uint32_t m = n - i < 1024 ? n - i : 1024;
+            filled.fill(buf, m);
+            for (uint32_t j = 0; j < m; j++) {
+                sum += buf[j];
+            }
+        }
+        std::cout << "fill()   " << kernel << " " << seconds_since(start) << " s  mean " << sum / n << "\n";
+    }
+
+    // the kernels must agree bit for bit, and stay close to libm
+    uint32_t differ = 0;
+    double worst = 0;
+    RandomStream plain(1, RNG_INTERARRIVAL), vector(1, RNG_INTERARRIVAL), check(1, RNG_INTERARRIVAL);
+    double a[1024], b[1024];
+    for (uint32_t i = 0; i < n; i += 1024) {
+        uint32_t m = n - i < 1024 ? n - i : 1024;
+        rng_avx2 = false;
+        plain.fill_exponential(a, m);
+        rng_avx2 = has_avx2;
+        vector.fill_exponential(b, m);
+        for (uint32_t j = 0; j < m; j++) {
+            differ += a[j] != b[j];
+            double libm = -log(check.uniform());
+            worst = std::max(worst, fabs(a[j] - libm) / libm);
+        }
+    }
+    std::cout << "kernels differ on " << differ << " of " << n << " draws, worst relative error vs libm " << worst << "\n";
+    return 0;
+}
@@ -1,14 +1,86 @@
 #include "stats.h"
 #include <cmath>
 #include <algorithm>
+#include <iostream>
+#include <iomanip>
 #include "assert.h"
 
+#define SKETCH_SUB_BUCKETS (1 << SKETCH_SUB_BUCKET_BITS)
+
+QuantileSketch::QuantileSketch()
+    : counts(1 + (SKETCH_MAX_EXP - SKETCH_MIN_EXP) * SKETCH_SUB_BUCKETS, 0)
+{
+    this->num = 0;
+    this->min = 0;
+    this->max = 0;
+}
+
+uint32_t QuantileSketch::bucket(double data){
+    if (data <= 0) {
+        return 0;
+    }
+    int exp;
+    double mantissa = frexp(data, &exp);   // in [0.5, 1)
+    if (exp < SKETCH_MIN_EXP) {
+        exp = SKETCH_MIN_EXP;
+        mantissa = 0.5;
+    }
+    if (exp >= SKETCH_MAX_EXP) {
+        exp = SKETCH_MAX_EXP - 1;
+        mantissa = 1.0 - 1e-9;
+    }
+    uint32_t sub = (uint32_t) ((mantissa - 0.5) * 2 * SKETCH_SUB_BUCKETS);
+    return 1 + (exp - SKETCH_MIN_EXP) * SKETCH_SUB_BUCKETS + sub;
+}
+
+// midpoint of the bucket
+double QuantileSketch::bucket_value(uint32_t b){
+    if (b == 0) {
+        return 0;
+    }
+    int exp = (b - 1) / SKETCH_SUB_BUCKETS + SKETCH_MIN_EXP;
+    uint32_t sub = (b - 1) % SKETCH_SUB_BUCKETS;
+    return ldexp(0.5 + (sub + 0.5) / (2 * SKETCH_SUB_BUCKETS), exp);
+}
+
+void QuantileSketch::add(double data){
+    if (num == 0 || data < min) {
+        min = data;
+    }
+    if (num == 0 || data > max) {
+        max = data;
+    }
+    num++;
+    counts[bucket(data)]++;
+}
+
+// same rank as Stats::get_percentile: the (int)(p*n)-th smallest sample
+double QuantileSketch::quantile(double p){
+    if (num == 0)
+        return -1;
+    uint64_t rank = (uint64_t) (p * num);
+    assert(rank < num);
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < counts.size(); b++) {
+        seen += counts[b];
+        if (seen > rank) {
+            return std::min(max, std::max(min, bucket_value(b)));
+        }
+    }
+    return max;
+}
+
+uint64_t QuantileSketch::size(){
+    return num;
+}
+
 Stats::Stats(bool get_dist)
 {
     this->sum = 0;
     this->sq_sum = 0;
     this->count = 0;
     this->get_dist = get_dist;
+    this->sorted = true;
 }
 
 
@@ -16,7 +88,13 @@ void Stats::input_data(double data){
     sum += data;
     sq_sum += data * data;
     count++;
-    raw.push_back(data);
+    if (get_dist) {
+        raw.push_back(data);
+        sorted = false;
+    }
+    else {
+        sketch.add(data);
+    }
 }
 
 void Stats::input_data(int data){
@@ -54,11 +132,54 @@ void Stats::set_precision()
 }
 
 double Stats::get_percentile(double p){
+    if (!get_dist)
+        return sketch.quantile(p);
     if(raw.size() == 0)
         return -1;
-    std::sort(raw.begin(), raw.end());
-    int loc = (int)(p*raw.size());
-    assert(loc >= 0 && loc < raw.size());
+    if (!sorted) {
+        std::sort(raw.begin(), raw.end());
+        sorted = true;
+    }
+    uint32_t loc = (uint32_t)(p*raw.size());
+    assert(loc < raw.size());
     return raw[loc];
 }
 
+uint32_t size_bucket(uint32_t size){
+    if (size < SIZE_BUCKET_SMALL) {
+        return 0;
+    }
+    if (size <= SIZE_BUCKET_LARGE) {
+        return 1;
+    }
+    return 2;
+}
+
+void FlowSizeStats::add(uint32_t size, double fct_us, double slowdown){
+    uint32_t b = size_bucket(size);
+    this->fct[b] += fct_us;
+    this->slowdown[b] += slowdown;
+    this->fct[NUM_SIZE_BUCKETS - 1] += fct_us;
+    this->slowdown[NUM_SIZE_BUCKETS - 1] += slowdown;
+}
+
+void FlowSizeStats::print(){
+    const char *names[NUM_SIZE_BUCKETS] = {"<10KB", "10KB-1MB", ">1MB", "all"};
+    std::cout << std::setprecision(4) << std::fixed;
+    for (int b = 0; b < NUM_SIZE_BUCKETS; b++) {
+        if (fct[b].size() == 0) {
+            continue;
+        }
+        std::cout << "FlowSize " << names[b] << " Count " << (int) fct[b].size()
+            << " FCT(us) mean " << fct[b].avg()
+            << " p50 " << fct[b].get_percentile(0.5)
+            << " p99 " << fct[b].get_percentile(0.99)
+            << " p99.9 " << fct[b].get_percentile(0.999)
+            << " Slowdown mean " << slowdown[b].avg()
+            << " p50 " << slowdown[b].get_percentile(0.5)
+            << " p99 " << slowdown[b].get_percentile(0.99)
+            << " p99.9 " << slowdown[b].get_percentile(0.999)
+            << "\n";
+    }
+    std::cout << std::setprecision(9) << std::fixed;
+}
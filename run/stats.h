@@ -3,16 +3,43 @@
 
 #include <map>
 #include <vector>
+#include <stdint.h>
+
+// Log-linear histogram over positive values (HDR histogram style): each
+// power of two is split into 2^SKETCH_SUB_BUCKET_BITS equal buckets, so a
+// quantile is within 1 / 2^(SKETCH_SUB_BUCKET_BITS+1) of the true value while
+// memory stays fixed no matter how many samples are added.
+#define SKETCH_SUB_BUCKET_BITS 7
+#define SKETCH_MIN_EXP -32
+#define SKETCH_MAX_EXP 64
+
+class QuantileSketch
+{
+private:
+    std::vector<uint64_t> counts;   // counts[0] holds values <= 0
+    uint64_t num;
+    double min;
+    double max;
+    uint32_t bucket(double data);
+    double bucket_value(uint32_t b);
+
+public:
+    QuantileSketch();
+    void add(double data);
+    double quantile(double p);
+    uint64_t size();
+};
+
 class Stats
 {
 private:
     double sum;
     double sq_sum;
     int count;
-    bool get_dist;
-    std::map<double, int> distribution;
-    int dist_round_precision;
+    bool get_dist;      // keep every sample for exact percentiles
+    bool sorted;
     std::vector<double> raw;
+    QuantileSketch sketch;
 
 public:
     Stats(bool get_dist = false);
@@ -28,5 +55,23 @@ public:
     double get_percentile(double p);
 };
 
+// FCT and slowdown of finished flows, by flow size
+#define SIZE_BUCKET_SMALL 10000      // bytes
+#define SIZE_BUCKET_LARGE 1000000
+#define NUM_SIZE_BUCKETS 4           // small, medium, large, all
+
+uint32_t size_bucket(uint32_t size);
+
+class FlowSizeStats
+{
+private:
+    Stats fct[NUM_SIZE_BUCKETS];
+    Stats slowdown[NUM_SIZE_BUCKETS];
+
+public:
+    void add(uint32_t size, double fct_us, double slowdown);
+    void print();
+};
+
 
 #endif